@@ -0,0 +1,17 @@
+REM Recursion emulated with GOSUB: counts the moves of a
+REM fifteen-disc Tower of Hanoi, restoring N after each call
+10 LET R=0
+20 LET M=0
+30 LET N=15
+40 GOSUB 100
+50 LET R=R+1
+60 IF R<60 THEN GOTO 20
+70 PRINT M
+80 END
+100 IF N=0 THEN RETURN
+110 LET N=N-1
+120 GOSUB 100
+130 LET M=M+1
+140 GOSUB 100
+150 LET N=N+1
+160 RETURN
@@ -0,0 +1,14 @@
+REM Nested counting loops
+10 LET I=0
+15 LET S=0
+20 LET J=0
+30 LET K=0
+40 LET K=K+1
+45 LET S=S*5+K-(S*5+K)/1000*1000
+50 IF K<100 THEN GOTO 40
+60 LET J=J+1
+70 IF J<100 THEN GOTO 30
+80 LET I=I+1
+90 IF I<500 THEN GOTO 20
+100 PRINT I," ",J," ",K," ",S
+110 END
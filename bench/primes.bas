@@ -0,0 +1,16 @@
+REM Primes below 5000 by trial division in scalar variables
+10 LET R=0
+20 LET C=0
+30 LET N=2
+40 LET D=2
+50 IF D*D>N THEN GOTO 90
+60 IF N/D*D=N THEN GOTO 100
+70 LET D=D+1
+80 GOTO 50
+90 LET C=C+1
+100 LET N=N+1
+110 IF N<5000 THEN GOTO 40
+120 LET R=R+1
+130 IF R<60 THEN GOTO 20
+140 PRINT C
+150 END
@@ -0,0 +1,9 @@
+REM A long PRINT loop mixing strings and numbers
+10 LET J=0
+20 LET I=0
+30 PRINT "LINE ",I," OF ",J,": ",I/3-J
+40 LET I=I+1
+50 IF I<30000 THEN GOTO 30
+60 LET J=J+1
+70 IF J<30 THEN GOTO 20
+80 END
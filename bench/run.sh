@@ -0,0 +1,160 @@
+#!/bin/sh
+#
+# Tiny BASIC Interpreter and Compiler Project
+# Benchmark Harness
+#
+# Released as Public Domain by Damian Gareth Walker 2019
+# Created: 17-Oct-2026
+#
+# Usage: run.sh [-u] TINYBASIC BASELINE
+#
+# Runs each bench/*.bas program in interpreter mode and as compiled C,
+# reporting the wall time and statements per second of each. Times are
+# compared with the baseline file, and any that are slower by more than
+# BENCH_THRESHOLD percent, and by more than 5ms to allow for timer
+# noise on very short runs, are reported as regressions, as are programs
+# that fail to compile to C. With -u, or
+# when there is no baseline yet, the baseline is written from this run
+# instead, counting the statements each program executes with the line
+# profiler. Times depend on the machine, so the baseline is kept locally
+# and never committed.
+#
+# Environment:
+#   CC                the C compiler for compiled mode (default gcc)
+#   BENCH_CFLAGS      flags for the C compiler (default -O2)
+#   BENCH_RUNS        runs per measurement, the best is kept (default 3)
+#   BENCH_THRESHOLD   percentage slowdown counted as a regression
+#                     (default 10)
+#
+
+# settings
+update=0
+if [ "$1" = "-u" ]; then
+  update=1
+  shift
+fi
+if [ $# -ne 2 ]; then
+  echo "Usage: $0 [-u] TINYBASIC BASELINE"
+  exit 1
+fi
+tinybasic=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+baseline=$2
+benchdir=$(cd "$(dirname "$0")" && pwd)
+if [ $update -eq 0 ] && [ ! -f "$baseline" ]; then
+  echo "No baseline in $baseline yet, so this run records one"
+  update=1
+fi
+cc=${CC:-gcc}
+cflags=${BENCH_CFLAGS:--O2}
+runs=${BENCH_RUNS:-3}
+threshold=${BENCH_THRESHOLD:-10}
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+
+# time a command, printing the best wall time in seconds
+best_time () {
+  best=""
+  run=0
+  while [ $run -lt $runs ]; do
+    start=$(date +%s.%N)
+    "$@" > /dev/null
+    finish=$(date +%s.%N)
+    best=$(awk -v s="$start" -v f="$finish" -v b="$best" \
+      'BEGIN { t = f - s; if (b == "" || t < b + 0) print t; else print b }')
+    run=$((run + 1))
+  done
+  echo "$best"
+}
+
+# look up a field from the baseline: program, field number
+baseline_field () {
+  [ -f "$baseline" ] && awk -v p="$1" -v n="$2" \
+    '$1 == p { print $n }' "$baseline"
+}
+
+# report a measurement and check it against the baseline
+report () {
+  program=$1
+  mode=$2
+  seconds=$3
+  statements=$4
+  base=$5
+  status=$(awk -v t="$seconds" -v b="$base" -v l="$threshold" 'BEGIN {
+    if (b == "") print "new";
+    else if (t > b * (1 + l / 100) && t - b > 0.005) print "REGRESSION";
+    else print "ok" }')
+  awk -v p="$program" -v m="$mode" -v t="$seconds" -v n="$statements" \
+    -v b="$base" -v s="$status" 'BEGIN {
+    printf "%-8s %-10s %9.4f s %12.0f stmt/s", p, m, t, (t > 0 ? n / t : 0);
+    if (b != "") printf "   baseline %9.4f s %+6.1f%%", b, 100 * (t - b) / b;
+    printf "   %s\n", s }'
+  [ "$status" != "REGRESSION" ]
+}
+
+# report a program that could not be compiled, with the compiler's errors
+report_failure () {
+  printf "%-8s %-10s compile failed   FAILURE\n" "$1" c
+  sed 's/^/    /' "$2" | head -10
+}
+
+# measure each program
+regressions=0
+failures=0
+[ $update -eq 1 ] && {
+  echo "# Tiny BASIC benchmark baseline: measured with $cc $cflags"
+  echo "# program statements interpret-seconds c-seconds"
+} > "$workdir/baseline"
+for source in "$benchdir"/*.bas; do
+  program=$(basename "$source" .bas)
+  cp "$source" "$workdir/$program.bas"
+  cd "$workdir" || exit 1
+
+  # count the statements, from the baseline or the profiler
+  if [ $update -eq 1 ] || [ -z "$(baseline_field "$program" 2)" ]; then
+    "$tinybasic" -P "$program.bas" > /dev/null
+    statements=$(awk 'NR == 1 { print $1 }' "$program.bas.prof")
+  else
+    statements=$(baseline_field "$program" 2)
+  fi
+
+  # time the interpreter and the compiled C, if it compiles
+  interpreted=$(best_time "$tinybasic" "$program.bas")
+  if "$tinybasic" -Oc "$program.bas" > "$program.err" 2>&1 \
+    && $cc $cflags -o "$program" "$program.bas.c" 2> "$program.err"; then
+    compiled=$(best_time "./$program")
+  else
+    compiled=""
+  fi
+  cd - > /dev/null || exit 1
+
+  # report or record the results
+  if [ -z "$compiled" ]; then
+    report "$program" interpret "$interpreted" "$statements" \
+      "$(baseline_field "$program" 3)" || regressions=$((regressions + 1))
+    report_failure "$program" "$workdir/$program.err"
+    failures=$((failures + 1))
+  elif [ $update -eq 1 ]; then
+    echo "$program $statements $interpreted $compiled" >> "$workdir/baseline"
+    report "$program" interpret "$interpreted" "$statements" ""
+    report "$program" c "$compiled" "$statements" ""
+  else
+    report "$program" interpret "$interpreted" "$statements" \
+      "$(baseline_field "$program" 3)" || regressions=$((regressions + 1))
+    report "$program" c "$compiled" "$statements" \
+      "$(baseline_field "$program" 4)" || regressions=$((regressions + 1))
+  fi
+done
+
+# save the baseline, or summarise the regressions and failures
+if [ $failures -gt 0 ]; then
+  echo "$failures program(s) failed to compile"
+  [ $update -eq 1 ] && echo "Baseline not written"
+  exit 1
+elif [ $update -eq 1 ]; then
+  cp "$workdir/baseline" "$baseline"
+  echo "Baseline written to $baseline"
+elif [ $regressions -gt 0 ]; then
+  echo "$regressions regression(s) above $threshold%"
+  exit 1
+fi
+exit 0
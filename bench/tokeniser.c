@@ -0,0 +1,135 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Tokeniser Microbenchmark
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "token.h"
+#include "tokeniser.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* default number of lines in the generated source */
+#define DEFAULT_LINES 100000
+
+/* default number of times to tokenise the source */
+#define DEFAULT_PASSES 20
+
+/* a keyword-heavy line template, cycled through as the source is built */
+static char *templates[] = {
+  "%d LET A=A+1\n",
+  "%d IF A<=B THEN GOTO %d\n",
+  "%d GOSUB %d\n",
+  "%d PRINT \"A=\",A,\" B=\",B\n",
+  "%d INPUT A,B\n",
+  "%d REM a comment line\n",
+  "%d RETURN\n",
+  "%d IF B>=A THEN PRINT \"ok\"\n",
+  "%d END\n",
+  NULL
+};
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Generate a source file in a temporary file
+ * params:
+ *   int     lines   the number of lines to generate
+ * returns:
+ *   FILE*           the temporary file, rewound
+ */
+static FILE *generate_source (int lines) {
+
+  /* local variables */
+  FILE *output; /* the temporary file */
+  int line, /* line counter */
+    template = 0; /* the template for the line */
+
+  /* write the lines */
+  output = tmpfile ();
+  for (line = 1; line <= lines; ++line) {
+    fprintf (output, templates [template], line, (line * 7) % lines + 1);
+    if (! templates [++template])
+      template = 0;
+  }
+
+  /* rewind and return */
+  rewind (output);
+  return output;
+}
+
+
+/*
+ * Main Program
+ */
+
+
+/*
+ * Top level function
+ * params:
+ *   int     argc   number of command line arguments
+ *   char**  argv   the command line arguments
+ * returns:
+ *   int            0 on success, 1 on error
+ */
+int main (int argc, char **argv) {
+
+  /* local variables */
+  FILE *input; /* the source to tokenise */
+  TokenStream *stream; /* a token stream for one pass */
+  TokenRecord *tokens; /* the tokens produced */
+  int count, /* number of tokens produced */
+    passes = DEFAULT_PASSES, /* number of passes to make */
+    pass; /* pass counter */
+  long size; /* size of the source in bytes */
+  clock_t start; /* clock at the start of the passes */
+  double seconds; /* time taken by all passes */
+
+  /* tokenise a named file, or a generated one */
+  if (argc > 1 && ! (input = fopen (argv [1], "r"))) {
+    printf ("Error: cannot open file %s\n", argv [1]);
+    return 1;
+  } else if (argc <= 1)
+    input = generate_source (DEFAULT_LINES);
+  if (argc > 2)
+    passes = atoi (argv [2]);
+  fseek (input, 0, SEEK_END);
+  size = ftell (input);
+
+  /* time the passes, including reading the file */
+  count = 0;
+  start = clock ();
+  for (pass = 0; pass < passes; ++pass) {
+    rewind (input);
+    stream = new_TokenStream (input);
+    tokens = stream->read_all (stream, &count);
+    free (tokens);
+    stream->destroy (stream);
+  }
+  seconds = (double) (clock () - start) / CLOCKS_PER_SEC;
+  fclose (input);
+
+  /* report the results */
+  printf ("%ld bytes, %d tokens, %d passes, %.3f s\n",
+    size, count, passes, seconds);
+  if (seconds > 0)
+    printf ("%.1f MB/s, %.1f Mtokens/s\n",
+      size * passes / seconds / 1e6, count * passes / seconds / 1e6);
+  return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Arena Allocator Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+
+/* included headers */
+#include <stddef.h>
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* a block of memory from which allocations are carved */
+typedef struct arena_block ArenaBlock;
+typedef struct arena_block {
+  ArenaBlock *next; /* the block allocated before this one */
+  size_t size; /* the usable size of this block */
+  size_t used; /* the number of bytes already allocated */
+} ArenaBlock;
+
+/* the arena */
+typedef struct {
+  ArenaBlock *blocks; /* the most recently allocated block */
+} Arena;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Create an empty arena
+ * returns:
+ *   Arena*   the new arena
+ */
+Arena *arena_create (void);
+
+/*
+ * Select the arena that subsequent allocations will use
+ * params:
+ *   Arena*   arena   the arena to allocate from
+ */
+void arena_select (Arena *arena);
+
+/*
+ * Allocate memory from the selected arena
+ * params:
+ *   size_t   size   the number of bytes required
+ * returns:
+ *   void*           the allocated memory
+ */
+void *arena_allocate (size_t size);
+
+/*
+ * Destroy an arena, and everything allocated from it
+ * params:
+ *   Arena*   arena   the doomed arena
+ */
+void arena_destroy (Arena *arena);
+
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Bytecode Compiler and Virtual Machine Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+
+/* included headers */
+#include "errors.h"
+#include "options.h"
+#include "statement.h"
+#include "input.h"
+
+
+/*
+ * Data Declarations
+ */
+
+
+/* the bytecode instructions */
+typedef enum {
+  OP_END, /* stop the program */
+  OP_PUSH_VALUE, /* push the constant operand onto the stack */
+  OP_PUSH_VARIABLE, /* push the variable operand onto the stack */
+  OP_STORE, /* pop the stack into the variable operand */
+  OP_NEGATE, /* negate the top of the stack */
+  OP_ADD, /* pop two values and push their sum */
+  OP_SUBTRACT, /* pop two values and push their difference */
+  OP_MULTIPLY, /* pop two values and push their product */
+  OP_DIVIDE, /* pop two values and push their quotient */
+  OP_BRANCH_EQUAL, /* pop two values, branch to the operand if = */
+  OP_BRANCH_UNEQUAL, /* pop two values, branch to the operand if <> */
+  OP_BRANCH_LESSTHAN, /* pop two values, branch to the operand if < */
+  OP_BRANCH_LESSOREQUAL, /* pop two values, branch to the operand if <= */
+  OP_BRANCH_GREATERTHAN, /* pop two values, branch to the operand if > */
+  OP_BRANCH_GREATEROREQUAL, /* pop two values, branch to the operand if >= */
+  OP_JUMP, /* jump to the operand */
+  OP_GOTO, /* pop a line label and jump to that line */
+  OP_CALL, /* push the return address and jump to the operand */
+  OP_GOSUB, /* pop a line label, push the return address, jump to the line */
+  OP_RETURN, /* pop a return address and jump to it */
+  OP_PRINT_STRING, /* print the string numbered by the operand */
+  OP_PRINT_VALUE, /* pop a value and print it */
+  OP_PRINT_NEWLINE, /* end a line of output */
+  OP_INPUT /* input values into the counted list of variables that follows */
+} Opcode;
+
+/* the bytecode object */
+typedef struct bytecode_data BytecodeData;
+typedef struct bytecode Bytecode;
+typedef struct bytecode {
+
+  /* Properties */
+  BytecodeData *priv; /* private data */
+
+  /*
+   * Compile a program into bytecode
+   * params:
+   *   Bytecode*      the bytecode object to compile into
+   *   ProgramNode*   the program to compile
+   */
+  void (*compile) (Bytecode *, ProgramNode *);
+
+  /*
+   * Run the compiled bytecode
+   * params:
+   *   Bytecode*   the bytecode object to run
+   */
+  void (*run) (Bytecode *);
+
+  /*
+   * Return the deepest the GOSUB stack has been
+   * params:
+   *   Bytecode*   the bytecode object to query
+   * returns:
+   *   int         the peak number of nested GOSUBs
+   */
+  int (*get_gosub_peak) (Bytecode *);
+
+  /*
+   * Choose where INPUT statements read from
+   * params:
+   *   Bytecode*      the bytecode object to configure
+   *   InputBuffer*   the input buffer, or NULL for stdin
+   */
+  void (*set_input) (Bytecode *, InputBuffer *);
+
+  /*
+   * Destructor
+   * params:
+   *   Bytecode*   the doomed bytecode object
+   */
+  void (*destroy) (Bytecode *);
+
+} Bytecode;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Constructor
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   Bytecode*                    the new bytecode object
+ */
+Bytecode *new_Bytecode (ErrorHandler *errors, LanguageOptions *options);
+
+
+#endif
@@ -35,6 +35,7 @@ typedef enum {
   E_OVERFLOW, /* integer is out of range */
   E_MEMORY, /* out of memory */
   E_TOO_MANY_GOSUBS, /* recursive GOSUBs exceeded the stack size */
+  E_END_OF_INPUT, /* INPUT found no number before the input ran out */
   E_LAST /* placeholder */
 } ErrorCode;
 
@@ -83,10 +83,31 @@ typedef struct right_hand_term {
   RightHandTerm *next; /* next part of the expression, if any */
 } RightHandTerm;
 
+/* The operations of a flattened expression */
+typedef enum {
+  EXPRESSION_OP_VALUE, /* push the operand as a constant */
+  EXPRESSION_OP_VARIABLE, /* push the variable numbered by the operand */
+  EXPRESSION_OP_NEGATE, /* negate the top of the stack */
+  EXPRESSION_OP_GROUP, /* the top of the stack was in brackets */
+  EXPRESSION_OP_ADD, /* pop two values and push their sum */
+  EXPRESSION_OP_SUBTRACT, /* pop two values and push their difference */
+  EXPRESSION_OP_MULTIPLY, /* pop two values and push their product */
+  EXPRESSION_OP_DIVIDE /* pop two values and push their quotient */
+} ExpressionOpClass;
+
+/* One operation of a flattened expression */
+typedef struct {
+  short op; /* the ExpressionOpClass of the operation */
+  short operand; /* the value or variable for the push operations */
+} ExpressionOp;
+
 /* An expression */
 typedef struct expression_node {
   TermNode *term; /* The first term of an expression */
   RightHandTerm *next; /* the right side expression, if any */
+  ExpressionOp *ops; /* the expression in postfix order, once flattened */
+  int op_count; /* the number of operations in ops */
+  int depth; /* the deepest the evaluation stack gets */
 } ExpressionNode;
 
 
@@ -102,13 +123,6 @@ typedef struct expression_node {
  */
 FactorNode *factor_create (void);
 
-/*
- * Destructor for a factor
- * params:
- *   FactorNode*   factor   the doomed factor
- */
-void factor_destroy (FactorNode *factor);
-
 /*
  * Constructor for a right-hand factor of a term
  * returns:
@@ -116,13 +130,6 @@ void factor_destroy (FactorNode *factor);
  */
 RightHandFactor *rhfactor_create (void);
 
-/*
- * Recursive destructor for a right-hand factor of a term
- * params:
- *   RightHandFactor*   rhterm   the doomed RH factor of a term
- */
-void rhfactor_destroy (RightHandFactor *rhterm);
-
 /*
  * Constructor for a term
  * returns:
@@ -130,13 +137,6 @@ void rhfactor_destroy (RightHandFactor *rhterm);
  */
 TermNode *term_create (void);
 
-/*
- * Destructor for a term
- * params:
- *   TermNode*   term   the doomed term
- */
-void term_destroy (TermNode *term);
-
 /*
  * Constructor for a right-hand expression
  * returns:
@@ -144,13 +144,6 @@ void term_destroy (TermNode *term);
  */
 RightHandTerm *rhterm_create (void);
 
-/*
- * Recursive destructor for a right-hand term of an expression
- * params:
- *   RightHandTerm*   rhexpression   the doomed RH expression
- */
-void rhterm_destroy (RightHandTerm *rhterm);
-
 /*
  * Constructor for an expression
  * returns:
@@ -159,18 +152,30 @@ void rhterm_destroy (RightHandTerm *rhterm);
 ExpressionNode *expression_create (void);
 
 /*
- * Destructor for a factor
+ * Flatten an expression into a postfix array of operations
+ * The array is allocated from the currently selected arena.
+ * params:
+ *   ExpressionNode*   expression   the expression to flatten
+ */
+void expression_flatten (ExpressionNode *expression);
+
+/*
+ * Fold the constants and remove the identities in a flattened expression
+ * Anything that would raise an error is left to raise it at run time.
  * params:
- *   FactorNode*   factor   the doomed factor
+ *   ExpressionNode*   expression   the expression to fold
  */
-void factor_destroy (FactorNode *factor);
+void expression_fold (ExpressionNode *expression);
 
 /*
- * Destructor for a expression
+ * Find the first operation of the operand that ends at a given operation
  * params:
- *   ExpressionNode*   expression   the doomed expression
+ *   ExpressionNode*   expression   the flattened expression
+ *   int               end          index of the operand's last operation
+ * returns:
+ *   int                            index of the operand's first operation
  */
-void expression_destroy (ExpressionNode *expression);
+int expression_operand_start (ExpressionNode *expression, int end);
 
 
 #endif
@@ -12,6 +12,7 @@
 
 
 /* included headers */
+#include <stdio.h>
 #include "errors.h"
 #include "statement.h"
 
@@ -28,15 +29,13 @@ typedef struct formatter {
 
   /* Properties */
   FormatterData *priv; /* private data */
-  char *output; /* the formatted output */
+  FILE *output; /* the stream the listing is written to */
 
   /*
-   * Create a formatted version of the program
+   * Write a formatted version of the program to the output stream
    * params:
    *   Formatter*     the formatter
    *   ProgramNode*   the syntax tree
-   * returns:
-   *   char*          the formatted BASIC program
    */
   void (*generate) (Formatter *, ProgramNode *);
 
@@ -57,10 +56,13 @@ typedef struct formatter {
 
 /*
  * The Formatter constructor
+ * params:
+ *   ErrorHandler*   errors   the error handler object
+ *   FILE*           output   the stream to write the listing to
  * returns:
- *   Formatter*   the new formatter
+ *   Formatter*               the new formatter
  */
-Formatter *new_Formatter (ErrorHandler *errors);
+Formatter *new_Formatter (ErrorHandler *errors, FILE *output);
 
 
 #endif
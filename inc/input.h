@@ -0,0 +1,80 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Input Buffer Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+
+/* included headers */
+#include <stdio.h>
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* input read in blocks, from which INPUT statements take their numbers */
+typedef struct {
+  FILE *stream; /* the stream refilled from, or NULL if fully loaded */
+  int owned; /* !0 if the stream is closed with the buffer */
+  char *buffer; /* the characters read */
+  int length; /* the number of characters in the buffer */
+  int position; /* the next character to be taken from the buffer */
+  int size; /* the number of characters the buffer can hold */
+} InputBuffer;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Create an input buffer that reads blocks from a stream as needed
+ * params:
+ *   FILE*   stream   the stream to read
+ * returns:
+ *   InputBuffer*     the new input buffer
+ */
+InputBuffer *input_create (FILE *stream);
+
+/*
+ * Create an input buffer holding the whole of a prepared input file
+ * A file with no size, such as a pipe, is read in blocks as needed.
+ * params:
+ *   char*   filename   the name of the file to load
+ * returns:
+ *   InputBuffer*       the new input buffer, or NULL if it cannot be read
+ */
+InputBuffer *input_load (char *filename);
+
+/*
+ * Read a number for an INPUT statement
+ * Anything before the first digit is skipped, except that a minus sign
+ * immediately before it makes the number negative.
+ * params:
+ *   InputBuffer*   input   the input buffer
+ *   int*           value   the place to store the number
+ *   int*           ch      the last character read, 0 at first
+ * returns:
+ *   int                    1 if the number was in range, 0 if it was not,
+ *                          or EOF if the input ran out first
+ */
+int input_number (InputBuffer *input, int *value, int *ch);
+
+/*
+ * Destroy an input buffer, leaving its stream open unless it loaded it
+ * params:
+ *   InputBuffer*   input   the doomed input buffer
+ */
+void input_destroy (InputBuffer *input);
+
+
+#endif
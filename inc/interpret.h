@@ -15,6 +15,8 @@
 #include "errors.h"
 #include "options.h"
 #include "statement.h"
+#include "profile.h"
+#include "input.h"
 
 
 /*
@@ -22,6 +24,14 @@
  */
 
 
+/* when buffered PRINT output is passed on to the output stream */
+typedef enum {
+  FLUSH_AUTO, /* a line at a time to a terminal, otherwise by the block */
+  FLUSH_LINE, /* at the end of every line printed */
+  FLUSH_BLOCK, /* whenever the buffer is full */
+  FLUSH_EXIT /* only before INPUT and when the program stops */
+} FlushPolicy;
+
 /* the interpreter object */
 typedef struct interpreter_data InterpreterData;
 typedef struct interpreter Interpreter;
@@ -38,6 +48,47 @@ typedef struct interpreter {
    */
   void (*interpret) (Interpreter *, ProgramNode *);
 
+  /*
+   * Return the deepest the GOSUB stack has been
+   * params:
+   *   Interpreter*   the interpreter to query
+   * returns:
+   *   int            the peak number of nested GOSUBs
+   */
+  int (*get_gosub_peak) (Interpreter *);
+
+  /*
+   * Record a profile of each program line while interpreting
+   * params:
+   *   Interpreter*   the interpreter to profile
+   *   Profile*       the profile to record, or NULL for none
+   */
+  void (*set_profile) (Interpreter *, Profile *);
+
+  /*
+   * Choose when buffered PRINT output is passed on to the output stream
+   * params:
+   *   Interpreter*   the interpreter to configure
+   *   FlushPolicy    the flush policy
+   */
+  void (*set_flush_policy) (Interpreter *, FlushPolicy);
+
+  /*
+   * Choose where INPUT statements read from
+   * params:
+   *   Interpreter*   the interpreter to configure
+   *   InputBuffer*   the input buffer, or NULL for stdin
+   */
+  void (*set_input) (Interpreter *, InputBuffer *);
+
+  /*
+   * Choose whether hot loops are traced and compiled to native code
+   * params:
+   *   Interpreter*   the interpreter to configure
+   *   int            !0 to trace hot loops
+   */
+  void (*set_tracing) (Interpreter *, int);
+
   /*
    * Destructor
    * params:
@@ -0,0 +1,122 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Native Code Compiler Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __JIT_H__
+#define __JIT_H__
+
+
+/* included headers */
+#include "errors.h"
+#include "options.h"
+#include "statement.h"
+#include "input.h"
+#include "interpret.h"
+
+
+/*
+ * Data Declarations
+ */
+
+
+/* the native code compiler object */
+typedef struct jit_data JITData;
+typedef struct jit JIT;
+typedef struct jit {
+
+  /* Properties */
+  JITData *priv; /* private data */
+
+  /*
+   * Compile a program into native code
+   * params:
+   *   JIT*           the compiler to use
+   *   ProgramNode*   the program to compile
+   */
+  void (*compile) (JIT *, ProgramNode *);
+
+  /*
+   * Run the compiled native code
+   * params:
+   *   JIT*   the compiler whose code is to be run
+   */
+  void (*run) (JIT *);
+
+  /*
+   * Compile a recorded trace of a loop into native code
+   * params:
+   *   JIT*               the compiler to use
+   *   ProgramLineNode**  the lines executed, starting at the loop head
+   *   int*               !0 for each IF whose condition held
+   *   int                the number of lines in the trace
+   */
+  void (*compile_trace) (JIT *, ProgramLineNode **, int *, int);
+
+  /*
+   * Run a compiled trace until one of its guards fails
+   * params:
+   *   JIT*               the compiler whose trace is to be run
+   *   int*               the program's variables
+   * returns:
+   *   ProgramLineNode*   the line at which interpretation resumes
+   */
+  ProgramLineNode *(*run_trace) (JIT *, int *);
+
+  /*
+   * Return the deepest the GOSUB stack has been
+   * params:
+   *   JIT*   the compiler to query
+   * returns:
+   *   int    the peak number of nested GOSUBs
+   */
+  int (*get_gosub_peak) (JIT *);
+
+  /*
+   * Choose when buffered PRINT output is passed on to the output stream
+   * params:
+   *   JIT*          the compiler to configure
+   *   FlushPolicy   the flush policy
+   */
+  void (*set_flush_policy) (JIT *, FlushPolicy);
+
+  /*
+   * Choose where INPUT statements read from
+   * params:
+   *   JIT*           the compiler to configure
+   *   InputBuffer*   the input buffer, or NULL for stdin
+   */
+  void (*set_input) (JIT *, InputBuffer *);
+
+  /*
+   * Destructor
+   * params:
+   *   JIT*   the doomed compiler
+   */
+  void (*destroy) (JIT *);
+
+} JIT;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Constructor
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   JIT*                         the new compiler, or NULL if native code
+ *                                cannot be generated or run on this machine
+ */
+JIT *new_JIT (ErrorHandler *errors, LanguageOptions *options);
+
+
+#endif
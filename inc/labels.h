@@ -0,0 +1,76 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Line Label Index Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __LABELS_H__
+#define __LABELS_H__
+
+
+/* included headers */
+#include "options.h"
+#include "statement.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* a line label and the index of the line that carries it */
+typedef struct {
+  int label; /* the line label */
+  int line; /* index of the line in program order */
+} LabelEntry;
+
+/* the label index */
+typedef struct {
+  ProgramLineNode **lines; /* the program lines in program order */
+  int line_count; /* the number of program lines */
+  int *dense; /* line index for each label, if labels are bounded */
+  int dense_size; /* number of entries in the dense table */
+  LabelEntry *sorted; /* labels in ascending order, if not bounded */
+  int sorted_count; /* number of entries in the sorted table */
+  int exact; /* !0 if labels must match exactly (optional line numbers) */
+} LabelIndex;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Build a label index for a program
+ * params:
+ *   ProgramNode*       program   the program to index
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   LabelIndex*                  the new label index
+ */
+LabelIndex *label_index_create (ProgramNode *program,
+  LanguageOptions *options);
+
+/*
+ * Find the line a GOTO or GOSUB would reach for a given label
+ * params:
+ *   LabelIndex*   index   the label index
+ *   int           label   the label to look for
+ * returns:
+ *   int                   the index of the line, or -1 if there is none
+ */
+int label_index_find (LabelIndex *index, int label);
+
+/*
+ * Destroy a label index
+ * params:
+ *   LabelIndex*   index   the doomed label index
+ */
+void label_index_destroy (LabelIndex *index);
+
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Linker Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __LINKER_H__
+#define __LINKER_H__
+
+
+/* included headers */
+#include "errors.h"
+#include "options.h"
+#include "statement.h"
+
+
+/*
+ * Data Declarations
+ */
+
+
+/* the linker object */
+typedef struct linker_data LinkerData;
+typedef struct linker Linker;
+typedef struct linker {
+
+  /* Properties */
+  LinkerData *priv; /* private data */
+
+  /*
+   * Resolve the constant GOTO and GOSUB targets in a program
+   * params:
+   *   Linker*        the linker to use
+   *   ProgramNode*   the program to link
+   */
+  void (*link) (Linker *, ProgramNode *);
+
+  /*
+   * Destructor
+   * params:
+   *   Linker*   the doomed linker
+   */
+  void (*destroy) (Linker *);
+
+} Linker;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Constructor
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   Linker*                      the new linker
+ */
+Linker *new_Linker (ErrorHandler *errors, LanguageOptions *options);
+
+
+#endif
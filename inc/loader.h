@@ -0,0 +1,52 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Shared Object Loader Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Work out where the shared object for a program is cached
+ * params:
+ *   char*   c_source   the C program
+ *   char*   command    the compiler command
+ * returns:
+ *   char*              the path of the shared object, which the caller
+ *                      frees, or NULL if there is no cache directory
+ */
+char *loader_cache_path (char *c_source, char *command);
+
+/*
+ * Compile a C program into a shared object in the cache
+ * params:
+ *   char*   path       the cache path of the shared object
+ *   char*   c_source   the C program
+ *   char*   command    the compiler command, with $(SOURCE) and $(TARGET)
+ * returns:
+ *   int                !0 if the shared object was built
+ */
+int loader_build (char *path, char *c_source, char *command);
+
+/*
+ * Load a shared object and run its program
+ * The program normally ends the process itself, with its exit code.
+ * params:
+ *   char*   path   the path of the shared object
+ * returns:
+ *   int            0 if the shared object could not be loaded
+ */
+int loader_run (char *path);
+
+
+#endif
@@ -45,6 +45,17 @@ typedef struct parser {
    */
   ProgramNode *(*parse) (Parser *);
 
+  /*
+   * Parse a whole program from an array of tokens
+   * params:
+   *   Parser*        The parser to use
+   *   TokenRecord*   The tokens, the last of which is TOKEN_EOF
+   *   int            The number of tokens
+   * returns:
+   *   ProgramNode*   The parsed program
+   */
+  ProgramNode *(*parse_tokens) (Parser *, TokenRecord *, int);
+
   /*
    * Return the current source line we're parsing
    * params:
@@ -83,7 +94,7 @@ typedef struct parser {
  * params:
  *   ErrorHandler*      the error handler to use
  *   LanguageOptions*   the language options to use
- *   FILE*              the input file
+ *   FILE*              the input file, or NULL to parse tokens
  * returns:
  *   Parser*            the new parser
  */
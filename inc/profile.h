@@ -0,0 +1,121 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Line Profiler Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+
+/* included headers */
+#include <stdio.h>
+#include <time.h>
+#include "statement.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the measurements taken for one program line */
+typedef struct {
+  ProgramLineNode *line; /* the program line measured */
+  long count; /* number of times the line was executed */
+  clock_t self_time; /* time spent executing the line itself */
+  long calls; /* number of GOSUBs that entered the line */
+  clock_t call_time; /* time spent in subroutines entered at the line */
+  int active; /* number of those subroutines not yet returned from */
+} ProfileEntry;
+
+/* the profile of a program run */
+typedef struct {
+  ProfileEntry *entries; /* an entry for each source line */
+  int entry_count; /* the number of entries */
+  ProfileEntry **calls; /* the subroutine entered by each active GOSUB */
+  clock_t *call_starts; /* the time each active GOSUB was made */
+  int call_depth; /* the number of active GOSUBs */
+  int call_capacity; /* the number of GOSUBs the call stack can hold */
+  long statements; /* the total number of statements executed */
+  clock_t total_time; /* the total time spent executing statements */
+} Profile;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Create an empty profile for a program
+ * params:
+ *   ProgramNode*   program   the program to be profiled
+ * returns:
+ *   Profile*                 the new profile
+ */
+Profile *profile_create (ProgramNode *program);
+
+/*
+ * Record the execution of a program line
+ * params:
+ *   Profile*           profile   the profile to record in
+ *   ProgramLineNode*   line      the line executed
+ *   clock_t            elapsed   the time the line took
+ */
+void profile_statement (Profile *profile, ProgramLineNode *line,
+  clock_t elapsed);
+
+/*
+ * Record a GOSUB entering a subroutine
+ * params:
+ *   Profile*           profile   the profile to record in
+ *   ProgramLineNode*   target    the first line of the subroutine
+ *   clock_t            now       the time the subroutine was entered
+ */
+void profile_call (Profile *profile, ProgramLineNode *target, clock_t now);
+
+/*
+ * Record a RETURN from the most recent subroutine
+ * params:
+ *   Profile*   profile   the profile to record in
+ *   clock_t    now       the time the subroutine returned
+ */
+void profile_return (Profile *profile, clock_t now);
+
+/*
+ * Close any subroutines still active when the program stops
+ * params:
+ *   Profile*   profile   the profile to finish
+ *   clock_t    now       the time the program stopped
+ */
+void profile_finish (Profile *profile, clock_t now);
+
+/*
+ * Write a text report, busiest lines first
+ * params:
+ *   Profile*   profile   the profile to report
+ *   FILE*      output    the stream to write to
+ */
+void profile_write_text (Profile *profile, FILE *output);
+
+/*
+ * Write a JSON report, busiest lines first
+ * params:
+ *   Profile*   profile   the profile to report
+ *   FILE*      output    the stream to write to
+ */
+void profile_write_json (Profile *profile, FILE *output);
+
+/*
+ * Destroy a profile
+ * params:
+ *   Profile*   profile   the doomed profile
+ */
+void profile_destroy (Profile *profile);
+
+
+#endif
@@ -12,6 +12,7 @@
 
 
 /* Pre-requisite headers */
+#include "arena.h"
 #include "expression.h"
 
 /* Forward Declarations */
@@ -89,13 +90,30 @@ typedef struct {
 /* Goto Statement Node */
 typedef struct {
   ExpressionNode *label; /* an expression that computes the label */
+  ProgramLineNode *target; /* the line reached, if the label is constant */
 } GotoStatementNode;
 
 /* Gosub Statement Node */
 typedef struct {
   ExpressionNode *label; /* an expression that computes the label */
+  ProgramLineNode *target; /* the line reached, if the label is constant */
 } GosubStatementNode;
 
+/* Step Statement Node, fused from LET variable=variable+operand */
+typedef struct {
+  int variable; /* the variable to step, 1..26 for A..Z */
+  ExpressionOp operand; /* the value or variable to add or subtract */
+  int subtract; /* !0 to subtract the operand rather than add it */
+} StepStatementNode;
+
+/* If-Goto Statement Node, fused from IF with simple operands THEN GOTO */
+typedef struct {
+  ExpressionOp left; /* the left-hand value or variable */
+  RelationalOperator op; /* the comparison operator used */
+  ExpressionOp right; /* the right-hand value or variable */
+  ProgramLineNode *target; /* the line reached if the condition holds */
+} IfGotoStatementNode;
+
 /* Statement classes */
 typedef enum {
   STATEMENT_NONE, /* unknown statement */
@@ -106,7 +124,9 @@ typedef enum {
   STATEMENT_RETURN, /* RETURN */
   STATEMENT_END, /* END */
   STATEMENT_PRINT, /* PRINT print-list */
-  STATEMENT_INPUT /* INPUT var-list */
+  STATEMENT_INPUT, /* INPUT var-list */
+  STATEMENT_STEP, /* LET var=var+operand, fused for the interpreter */
+  STATEMENT_IF_GOTO /* IF simple-condition THEN GOTO line, likewise */
 } StatementClass;
 
 /* Common Statement Node */
@@ -121,12 +141,15 @@ typedef struct statement_node {
     /* an END statement requires no extra data */
     PrintStatementNode *printn; /* a PRINT statement */
     InputStatementNode *inputn; /* an INPUT statement */
+    StepStatementNode *stepn; /* a fused step statement */
+    IfGotoStatementNode *ifgoton; /* a fused IF-GOTO statement */
   } statement;
 } StatementNode;
 
 /* a program line */
 typedef struct program_line_node {
   int label; /* line label */
+  int source_line; /* the source line the program line was read from */
   StatementNode *statement; /* the current statement */
   ProgramLineNode *next; /* the next statement */
 } ProgramLineNode;
@@ -135,6 +158,7 @@ typedef struct program_line_node {
 /* the program */
 typedef struct {
   ProgramLineNode *first; /* first program statement */
+  Arena *arena; /* the arena holding the program's nodes */
 } ProgramNode;
 
 
@@ -186,18 +210,25 @@ PrintStatementNode *statement_create_print (void);
 InputStatementNode *statement_create_input (void);
 
 /*
- * Statement constructor
+ * Step statement constructor
  * returns:
- *   StatementNode*   the newly-created blank statement
+ *   StepStatementNode*   the created step statement
  */
-StatementNode *statement_create (void);
+StepStatementNode *statement_create_step (void);
 
 /*
- * Statement destructor
- * params:
- *   StatementNode*   statement   the doomed statement
+ * IF-GOTO statement constructor
+ * returns:
+ *   IfGotoStatementNode*   the created IF-GOTO statement
+ */
+IfGotoStatementNode *statement_create_if_goto (void);
+
+/*
+ * Statement constructor
+ * returns:
+ *   StatementNode*   the newly-created blank statement
  */
-void statement_destroy (StatementNode *statement);
+StatementNode *statement_create (void);
 
 /*
  * Program Line Constructor
@@ -207,20 +238,35 @@ void statement_destroy (StatementNode *statement);
 ProgramLineNode *program_line_create (void);
 
 /*
- * Program Line Destructor
+ * Program Constructor
+ * The new program's arena is selected for the nodes that follow.
+ * returns:
+ *   ProgramNode*   the constructed program
+ */
+ProgramNode *program_create (void);
+
+/*
+ * Flatten every expression in a program into postfix operations
  * params:
- *   ProgramLineNode*   program_line   the doomed program line
+ *   ProgramNode*   program   the program to flatten
+ */
+void program_flatten (ProgramNode *program);
+
+/*
+ * Fold the constants and remove the identities in a flattened program
  * params:
- *   ProgramLineNode*                  the next program line
+ *   ProgramNode*   program   the program to optimise
  */
-ProgramLineNode *program_line_destroy (ProgramLineNode *program_line);
+void program_fold (ProgramNode *program);
 
 /*
- * Program Constructor
- * returns:
- *   ProgramNode*   the constructed program
+ * Replace common statement patterns with fused statements
+ * Fused statements are understood only by the interpreter, so this is
+ * done after linking and only when the program is to be interpreted.
+ * params:
+ *   ProgramNode*   program   the program to optimise
  */
-ProgramNode *program_create (void);
+void program_fuse (ProgramNode *program);
 
 /*
  * Program Destructor
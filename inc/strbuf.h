@@ -0,0 +1,84 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * String Buffer Header
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+#ifndef __STRBUF_H__
+#define __STRBUF_H__
+
+
+/* included headers */
+#include <stddef.h>
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* a string that grows as text is appended to it */
+typedef struct {
+  char *text; /* the text, always null-terminated */
+  size_t length; /* the length of the text */
+  size_t capacity; /* the space allocated for the text */
+} StringBuffer;
+
+
+/*
+ * Function Declarations
+ */
+
+
+/*
+ * Create an empty string buffer
+ * returns:
+ *   StringBuffer*   the new buffer
+ */
+StringBuffer *strbuf_create (void);
+
+/*
+ * Append text to a string buffer
+ * params:
+ *   StringBuffer*   buffer   the buffer to append to
+ *   char*           text     the text to append
+ */
+void strbuf_append (StringBuffer *buffer, char *text);
+
+/*
+ * Append a single character to a string buffer
+ * params:
+ *   StringBuffer*   buffer   the buffer to append to
+ *   char            ch       the character to append
+ */
+void strbuf_append_char (StringBuffer *buffer, char ch);
+
+/*
+ * Append an integer in decimal to a string buffer
+ * params:
+ *   StringBuffer*   buffer   the buffer to append to
+ *   int             value    the integer to append
+ */
+void strbuf_append_int (StringBuffer *buffer, int value);
+
+/*
+ * Destroy a string buffer, keeping its text
+ * params:
+ *   StringBuffer*   buffer   the doomed buffer
+ * returns:
+ *   char*                    the text, for the caller to free
+ */
+char *strbuf_release (StringBuffer *buffer);
+
+/*
+ * Destroy a string buffer and its text
+ * params:
+ *   StringBuffer*   buffer   the doomed buffer
+ */
+void strbuf_destroy (StringBuffer *buffer);
+
+
+#endif
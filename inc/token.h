@@ -53,6 +53,15 @@ typedef enum
    TOKEN_ILLEGAL /* unrecognised characters */
   } TokenClass;
 
+/* a token as a plain record, whose content is a slice of the source */
+typedef struct {
+  TokenClass class; /* class of token */
+  int line; /* line on which token was found */
+  int pos; /* position within the line on which token was found */
+  char *content; /* start of the token in the source text */
+  int length; /* length of the token in the source text */
+} TokenRecord;
+
 /* token structure */
 typedef struct token Token;
 typedef struct token
@@ -62,10 +71,11 @@ typedef struct token
   int (*get_line) (Token *);
   int (*get_pos) (Token *);
   char *(*get_content) (Token *);
+  int (*get_length) (Token *);
   void (*set_class) (Token *, TokenClass);
   void (*set_line_pos) (Token *, int, int);
-  void (*set_content) (Token *, char *);
-  void (*initialise) (Token *, TokenClass, int, int, char *);
+  void (*set_content) (Token *, char *, int);
+  void (*initialise) (Token *, TokenClass, int, int, char *, int);
   void (*destroy) (Token *); /* destructor */
 } Token;
 
@@ -84,15 +94,19 @@ Token *new_Token (void);
 
 /*
  * Token constructor with values to initialise
+ * The content is a slice of the source text, which is not copied and is
+ * not terminated, so it must outlive the token.
  * params:
  *   TokenClass   class     class of token to initialise
  *   int          line      line on which the token occurred
  *   int          pos       character position on which the token occurred
- *   char*        content   the textual content of the token
+ *   char*        content   the start of the token's source text
+ *   int          length    the length of the token's source text
  * returns:
  *   Token*                 the created token
  */
-Token *new_Token_init (TokenClass class, int line, int pos, char *content);
+Token *new_Token_init (TokenClass class, int line, int pos, char *content,
+  int length);
 
 
 #endif
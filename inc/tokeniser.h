@@ -25,6 +25,7 @@ typedef struct token_stream TokenStream;
 typedef struct token_stream {
   void *data; /* private data */
   Token *(*next) (TokenStream *);
+  TokenRecord *(*read_all) (TokenStream *, int *); /* caller frees array */
   int (*get_line) (TokenStream *);
   void (*destroy) (TokenStream *);
 } TokenStream;
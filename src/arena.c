@@ -0,0 +1,159 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Arena Allocator Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the usable size of an ordinary block */
+#define ARENA_BLOCK_SIZE 65536
+
+/* the alignment required for any kind of node */
+typedef union {
+  long integer; /* the widest integer */
+  double real; /* the widest floating point value */
+  void *pointer; /* any pointer */
+} ArenaAlign;
+#define ARENA_ALIGN (sizeof (ArenaAlign))
+
+/* the space taken by a block header, rounded up for alignment */
+#define ARENA_HEADER \
+  ((sizeof (ArenaBlock) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+/* convenience variables */
+static Arena *selected = NULL; /* the arena allocations are made from */
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Add a new block to the arena
+ * params:
+ *   Arena*   arena   the arena to grow
+ *   size_t   size    the usable size the block needs
+ * returns:
+ *   ArenaBlock*      the new block
+ */
+static ArenaBlock *add_block (Arena *arena, size_t size) {
+
+  /* local variables */
+  ArenaBlock *block; /* the new block */
+
+  /* allocate the block, large requests getting a block of their own */
+  if (size < ARENA_BLOCK_SIZE)
+    size = ARENA_BLOCK_SIZE;
+  block = malloc (ARENA_HEADER + size);
+  block->size = size;
+  block->used = 0;
+
+  /* link it in, keeping the current block at the head of the list */
+  if (arena->blocks && size > ARENA_BLOCK_SIZE) {
+    block->next = arena->blocks->next;
+    arena->blocks->next = block;
+  } else {
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+
+  /* return the block */
+  return block;
+}
+
+
+/*
+ * Top Level Routines
+ */
+
+
+/*
+ * Create an empty arena
+ * returns:
+ *   Arena*   the new arena
+ */
+Arena *arena_create (void) {
+
+  /* local variables */
+  Arena *arena; /* the new arena */
+
+  /* allocate memory and initialise members */
+  arena = malloc (sizeof (Arena));
+  arena->blocks = NULL;
+
+  /* return the arena */
+  return arena;
+}
+
+/*
+ * Select the arena that subsequent allocations will use
+ * params:
+ *   Arena*   arena   the arena to allocate from
+ */
+void arena_select (Arena *arena) {
+  selected = arena;
+}
+
+/*
+ * Allocate memory from the selected arena
+ * params:
+ *   size_t   size   the number of bytes required
+ * returns:
+ *   void*           the allocated memory
+ */
+void *arena_allocate (size_t size) {
+
+  /* local variables */
+  ArenaBlock *block; /* the block to allocate from */
+  void *memory; /* the allocated memory */
+
+  /* round up the size so the next allocation is aligned */
+  size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+
+  /* find a block with room, adding one if necessary */
+  block = selected->blocks;
+  if (! block || block->size - block->used < size)
+    block = add_block (selected, size);
+
+  /* carve out the memory */
+  memory = (char *) block + ARENA_HEADER + block->used;
+  block->used += size;
+  return memory;
+}
+
+/*
+ * Destroy an arena, and everything allocated from it
+ * params:
+ *   Arena*   arena   the doomed arena
+ */
+void arena_destroy (Arena *arena) {
+
+  /* local variables */
+  ArenaBlock *next; /* the next block to free */
+
+  /* free the blocks, then the arena itself */
+  if (arena) {
+    while (arena->blocks) {
+      next = arena->blocks->next;
+      free (arena->blocks);
+      arena->blocks = next;
+    }
+    if (selected == arena)
+      selected = NULL;
+    free (arena);
+  }
+}
@@ -0,0 +1,744 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Bytecode Compiler and Virtual Machine Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "errors.h"
+#include "options.h"
+#include "statement.h"
+#include "labels.h"
+
+
+/* forward declarations */
+static void compile_statement (StatementNode *statement);
+
+
+/*
+ * Data Definitions
+ */
+
+/* a program line as seen by the virtual machine */
+typedef struct {
+  int label; /* the line label */
+  int address; /* address of the line's first instruction */
+} BytecodeLine;
+
+/* a jump whose address is filled in after compilation */
+typedef struct {
+  int address; /* address of the operand to fill in */
+  int line; /* index of the line being jumped to */
+} BytecodeFixup;
+
+/* private data */
+typedef struct bytecode_data {
+  int *code; /* the compiled instructions */
+  int code_size; /* number of instruction cells used */
+  int code_max; /* number of instruction cells allocated */
+  char **strings; /* the literal strings used by PRINT */
+  int string_count; /* number of strings used */
+  int string_max; /* number of strings allocated */
+  BytecodeLine *lines; /* the program lines in program order */
+  LabelIndex *labels; /* index of the program's line labels */
+  int line_count; /* the number of program lines */
+  BytecodeFixup *fixups; /* jumps to be resolved after compilation */
+  int fixup_count; /* number of fixups used */
+  int fixup_max; /* number of fixups allocated */
+  int depth; /* current depth of the evaluation stack */
+  int max_depth; /* deepest the evaluation stack can go */
+  int *stack; /* the evaluation stack */
+  int **gosub_stack; /* the return addresses */
+  int gosub_peak; /* highest number of return addresses stacked */
+  int variables [26]; /* the numeric variables */
+  InputBuffer *input; /* where INPUT statements read from */
+  InputBuffer *standard_input; /* the buffer for reading stdin */
+  ErrorHandler *errors; /* the error handler */
+  LanguageOptions *options; /* the language options */
+} BytecodeData;
+
+/* convenience variables */
+static Bytecode *this; /* the object we are working with */
+
+
+/*
+ * Private Methods
+ */
+
+
+/*
+ * Append a cell to the compiled code
+ * params:
+ *   int   cell   the opcode or operand to append
+ */
+static void emit (int cell) {
+  if (this->priv->code_size == this->priv->code_max) {
+    this->priv->code_max *= 2;
+    this->priv->code = realloc (this->priv->code,
+      this->priv->code_max * sizeof (int));
+  }
+  this->priv->code [this->priv->code_size++] = cell;
+}
+
+/*
+ * Adjust the tracked evaluation stack depth
+ * params:
+ *   int   change   the number of values pushed (or popped if negative)
+ */
+static void adjust_depth (int change) {
+  this->priv->depth += change;
+  if (this->priv->depth > this->priv->max_depth)
+    this->priv->max_depth = this->priv->depth;
+}
+
+/*
+ * Find the index of a program line given its label
+ * params:
+ *   int   jump_label   the label to search for
+ * returns:
+ *   int                the index of the line, or -1 if none was found
+ */
+static int find_line (int jump_label) {
+  return label_index_find (this->priv->labels, jump_label);
+}
+
+/*
+ * Find the label of the line containing an instruction
+ * params:
+ *   int   address   the address of the instruction
+ * returns:
+ *   int             the label of the line
+ */
+static int find_address (int address) {
+
+  /* local variables */
+  int
+    low = 0, /* lowest line still being considered */
+    high, /* highest line still being considered */
+    middle; /* the line we're testing */
+
+  /* find the last line starting at or before the address */
+  high = this->priv->line_count - 1;
+  while (low < high) {
+    middle = (low + high + 1) / 2;
+    if (this->priv->lines [middle].address <= address)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+
+  /* return its label */
+  return this->priv->line_count ? this->priv->lines [low].label : 0;
+}
+
+/*
+ * Record a jump to a line to be resolved after compilation
+ * params:
+ *   int   line   the index of the line to jump to
+ */
+static void emit_fixup (int line) {
+  if (this->priv->fixup_count == this->priv->fixup_max) {
+    this->priv->fixup_max *= 2;
+    this->priv->fixups = realloc (this->priv->fixups,
+      this->priv->fixup_max * sizeof (BytecodeFixup));
+  }
+  this->priv->fixups [this->priv->fixup_count].address
+    = this->priv->code_size;
+  this->priv->fixups [this->priv->fixup_count++].line = line;
+  emit (0);
+}
+
+/*
+ * Determine if an expression is a simple constant
+ * params:
+ *   ExpressionNode*   expression   the expression to check
+ *   int*              value        the value of the constant, if it is one
+ * returns:
+ *   int                            !0 if the expression is a constant
+ */
+static int constant_expression (ExpressionNode *expression, int *value) {
+  if (expression->ops [0].op != EXPRESSION_OP_VALUE
+    || expression->op_count > 2
+    || (expression->op_count == 2
+      && expression->ops [1].op != EXPRESSION_OP_NEGATE))
+    return 0;
+  *value = expression->op_count == 2
+    ? -expression->ops [0].operand
+    : expression->ops [0].operand;
+  return 1;
+}
+
+
+/*
+ * Level 2 Compiler Routines
+ */
+
+
+/*
+ * Compile a flattened expression
+ * params:
+ *   ExpressionNode*   expression   the expression to compile
+ */
+static void compile_expression (ExpressionNode *expression) {
+
+  /* local variables */
+  ExpressionOp *op, /* the operation being compiled */
+    *end; /* the end of the expression's operations */
+
+  /* compile each operation in turn */
+  end = expression->ops + expression->op_count;
+  for (op = expression->ops; op < end; ++op)
+    switch (op->op) {
+      case EXPRESSION_OP_VALUE:
+
+        /* negative constants are pushed ready negated */
+        emit (OP_PUSH_VALUE);
+        if (op + 1 < end && op[1].op == EXPRESSION_OP_NEGATE) {
+          emit (-op->operand);
+          ++op;
+        } else
+          emit (op->operand);
+        adjust_depth (1);
+        break;
+      case EXPRESSION_OP_VARIABLE:
+        emit (OP_PUSH_VARIABLE);
+        emit (op->operand - 1);
+        adjust_depth (1);
+        break;
+      case EXPRESSION_OP_NEGATE:
+        emit (OP_NEGATE);
+        break;
+      case EXPRESSION_OP_GROUP:
+        break;
+      case EXPRESSION_OP_ADD:
+        emit (OP_ADD);
+        adjust_depth (-1);
+        break;
+      case EXPRESSION_OP_SUBTRACT:
+        emit (OP_SUBTRACT);
+        adjust_depth (-1);
+        break;
+      case EXPRESSION_OP_MULTIPLY:
+        emit (OP_MULTIPLY);
+        adjust_depth (-1);
+        break;
+      case EXPRESSION_OP_DIVIDE:
+        emit (OP_DIVIDE);
+        adjust_depth (-1);
+        break;
+      default:
+        this->priv->errors->set_code
+          (this->priv->errors, E_INVALID_EXPRESSION, 0, 0);
+    }
+}
+
+/*
+ * Compile a jump or call to a line label
+ * params:
+ *   ExpressionNode*   label     the expression giving the line label
+ *   Opcode            direct    instruction to use for a known line
+ *   Opcode            dynamic   instruction to use for a computed label
+ */
+static void compile_jump (ExpressionNode *label, Opcode direct,
+  Opcode dynamic) {
+
+  /* local variables */
+  int
+    value, /* the value of a constant label */
+    line; /* index of the line jumped to */
+
+  /* jump straight to constant labels that exist */
+  if (constant_expression (label, &value)
+    && (line = find_line (value)) != -1) {
+    emit (direct);
+    emit_fixup (line);
+  }
+
+  /* leave other labels to be evaluated at runtime */
+  else {
+    compile_expression (label);
+    emit (dynamic);
+    adjust_depth (-1);
+  }
+}
+
+
+/*
+ * Level 1 Compiler Routines
+ */
+
+
+/*
+ * Compile a LET statement
+ * params:
+ *   LetStatementNode*   letn   the LET statement details
+ */
+static void compile_let_statement (LetStatementNode *letn) {
+  compile_expression (letn->expression);
+  emit (OP_STORE);
+  emit (letn->variable - 1);
+  adjust_depth (-1);
+}
+
+/*
+ * Compile an IF statement
+ * params:
+ *   IfStatementNode*   ifn   the IF statement details
+ */
+static void compile_if_statement (IfStatementNode *ifn) {
+
+  /* local variables */
+  int skip; /* address of the operand for skipping the statement */
+
+  /* evaluate both sides of the condition */
+  compile_expression (ifn->left);
+  compile_expression (ifn->right);
+
+  /* branch past the conditional statement if the condition is false */
+  switch (ifn->op) {
+    case RELOP_EQUAL: emit (OP_BRANCH_UNEQUAL); break;
+    case RELOP_UNEQUAL: emit (OP_BRANCH_EQUAL); break;
+    case RELOP_LESSTHAN: emit (OP_BRANCH_GREATEROREQUAL); break;
+    case RELOP_LESSOREQUAL: emit (OP_BRANCH_GREATERTHAN); break;
+    case RELOP_GREATERTHAN: emit (OP_BRANCH_LESSOREQUAL); break;
+    case RELOP_GREATEROREQUAL: emit (OP_BRANCH_LESSTHAN); break;
+  }
+  adjust_depth (-2);
+  skip = this->priv->code_size;
+  emit (0);
+
+  /* compile the conditional statement and fill in the branch address */
+  compile_statement (ifn->statement);
+  this->priv->code [skip] = this->priv->code_size;
+}
+
+/*
+ * Compile a PRINT statement
+ * params:
+ *   PrintStatementNode*   printn   the PRINT statement details
+ */
+static void compile_print_statement (PrintStatementNode *printn) {
+
+  /* local variables */
+  OutputNode *outn; /* current output node */
+
+  /* compile each of the output items */
+  for (outn = printn->first; outn; outn = outn->next)
+    switch (outn->class) {
+      case OUTPUT_STRING:
+        if (this->priv->string_count == this->priv->string_max) {
+          this->priv->string_max *= 2;
+          this->priv->strings = realloc (this->priv->strings,
+            this->priv->string_max * sizeof (char *));
+        }
+        this->priv->strings [this->priv->string_count] = outn->output.string;
+        emit (OP_PRINT_STRING);
+        emit (this->priv->string_count++);
+        break;
+      case OUTPUT_EXPRESSION:
+        compile_expression (outn->output.expression);
+        emit (OP_PRINT_VALUE);
+        adjust_depth (-1);
+        break;
+    }
+
+  /* finish with the linefeed */
+  emit (OP_PRINT_NEWLINE);
+}
+
+/*
+ * Compile an INPUT statement
+ * params:
+ *   InputStatementNode*   inputn   the INPUT statement details
+ */
+static void compile_input_statement (InputStatementNode *inputn) {
+
+  /* local variables */
+  VariableListNode *variable; /* current variable to input */
+  int count = 0; /* the number of variables */
+
+  /* count the variables, then list them */
+  for (variable = inputn->first; variable; variable = variable->next)
+    ++count;
+  emit (OP_INPUT);
+  emit (count);
+  for (variable = inputn->first; variable; variable = variable->next)
+    emit (variable->variable - 1);
+}
+
+/*
+ * Compile an individual statement
+ * params:
+ *   StatementNode*   statement   the statement to compile
+ */
+static void compile_statement (StatementNode *statement) {
+
+  /* comments generate no code */
+  if (! statement)
+    return;
+
+  /* compile real statements */
+  switch (statement->class) {
+    case STATEMENT_NONE:
+      break;
+    case STATEMENT_LET:
+      compile_let_statement (statement->statement.letn);
+      break;
+    case STATEMENT_IF:
+      compile_if_statement (statement->statement.ifn);
+      break;
+    case STATEMENT_GOTO:
+      compile_jump (statement->statement.goton->label, OP_JUMP, OP_GOTO);
+      break;
+    case STATEMENT_GOSUB:
+      compile_jump (statement->statement.gosubn->label, OP_CALL, OP_GOSUB);
+      break;
+    case STATEMENT_RETURN:
+      emit (OP_RETURN);
+      break;
+    case STATEMENT_END:
+      emit (OP_END);
+      break;
+    case STATEMENT_PRINT:
+      compile_print_statement (statement->statement.printn);
+      break;
+    case STATEMENT_INPUT:
+      compile_input_statement (statement->statement.inputn);
+      break;
+    default:
+      this->priv->errors->set_code
+        (this->priv->errors, E_UNRECOGNISED_COMMAND, 0, 0);
+  }
+}
+
+
+/*
+ * Public Methods
+ */
+
+
+/*
+ * Compile a program into bytecode
+ * params:
+ *   Bytecode*      bytecode   the bytecode object to compile into
+ *   ProgramNode*   program    the program to compile
+ */
+static void compile (Bytecode *bytecode, ProgramNode *program) {
+
+  /* local variables */
+  ProgramLineNode *program_line; /* the line being compiled */
+  int count; /* line and fixup counter */
+
+  /* initialise */
+  this = bytecode;
+
+  /* gather the line labels so that jumps can be resolved */
+  this->priv->labels = label_index_create (program, this->priv->options);
+  this->priv->line_count = this->priv->labels->line_count;
+  this->priv->lines = malloc
+    ((this->priv->line_count + 1) * sizeof (BytecodeLine));
+  count = 0;
+  for (program_line = program->first; program_line;
+    program_line = program_line->next)
+    this->priv->lines [count++].label = program_line->label;
+
+  /* compile each line in turn, followed by an implicit END */
+  count = 0;
+  for (program_line = program->first; program_line;
+    program_line = program_line->next) {
+    this->priv->lines [count++].address = this->priv->code_size;
+    compile_statement (program_line->statement);
+  }
+  emit (OP_END);
+
+  /* resolve the jumps to known lines */
+  for (count = 0; count < this->priv->fixup_count; ++count)
+    this->priv->code [this->priv->fixups [count].address]
+      = this->priv->lines [this->priv->fixups [count].line].address;
+
+  /* allocate the stacks */
+  this->priv->stack = malloc ((this->priv->max_depth + 1) * sizeof (int));
+  this->priv->gosub_stack = malloc
+    ((this->priv->options->get_gosub_limit (this->priv->options) + 1)
+    * sizeof (int *));
+}
+
+/*
+ * Run the compiled bytecode
+ * params:
+ *   Bytecode*   bytecode   the bytecode object to run
+ */
+static void run (Bytecode *bytecode) {
+
+  /* local variables */
+  int
+    *code, /* start of the compiled code */
+    *pc, /* the current instruction */
+    *sp, /* the top of the evaluation stack */
+    *variables, /* the numeric variables */
+    **gosub_sp, /* the top of the GOSUB stack */
+    **gosub_limit, /* the limit of the GOSUB stack */
+    **gosub_peak, /* the highest point the GOSUB stack has reached */
+    line, /* a line found by a computed jump */
+    value, /* a value read by INPUT */
+    ch, /* the last character read by INPUT */
+    result, /* the result of reading a number */
+    count, /* the number of variables left to INPUT */
+    column = 0; /* !0 if the current output line is unfinished */
+  ErrorCode error = E_NONE; /* runtime error encountered */
+
+  /* initialise */
+  this = bytecode;
+  code = pc = this->priv->code;
+  sp = this->priv->stack;
+  variables = this->priv->variables;
+  memset (variables, 0, sizeof (this->priv->variables));
+  gosub_sp = gosub_peak = this->priv->gosub_stack;
+  gosub_limit = gosub_sp
+    + this->priv->options->get_gosub_limit (this->priv->options);
+
+  /* execute instructions until an END or an error */
+  while (pc && ! error)
+    switch (*pc++) {
+      case OP_END:
+        pc = NULL;
+        break;
+      case OP_PUSH_VALUE:
+        *++sp = *pc++;
+        break;
+      case OP_PUSH_VARIABLE:
+        if ((*++sp = variables [*pc++]) < -32768 || *sp > 32767)
+          error = E_OVERFLOW;
+        break;
+      case OP_STORE:
+        variables [*pc++] = *sp--;
+        break;
+      case OP_NEGATE:
+        if ((*sp = -*sp) > 32767)
+          error = E_OVERFLOW;
+        break;
+      case OP_ADD:
+        --sp;
+        if ((sp[0] += sp[1]) < -32768 || sp[0] > 32767)
+          error = E_OVERFLOW;
+        break;
+      case OP_SUBTRACT:
+        --sp;
+        if ((sp[0] -= sp[1]) < -32768 || sp[0] > 32767)
+          error = E_OVERFLOW;
+        break;
+      case OP_MULTIPLY:
+        --sp;
+        if ((sp[0] *= sp[1]) < -32768 || sp[0] > 32767)
+          error = E_OVERFLOW;
+        break;
+      case OP_DIVIDE:
+        --sp;
+        if (! sp[1])
+          error = E_DIVIDE_BY_ZERO;
+        else
+          sp[0] /= sp[1];
+        break;
+      case OP_BRANCH_EQUAL:
+        sp -= 2;
+        pc = (sp[1] == sp[2]) ? code + *pc : pc + 1;
+        break;
+      case OP_BRANCH_UNEQUAL:
+        sp -= 2;
+        pc = (sp[1] != sp[2]) ? code + *pc : pc + 1;
+        break;
+      case OP_BRANCH_LESSTHAN:
+        sp -= 2;
+        pc = (sp[1] < sp[2]) ? code + *pc : pc + 1;
+        break;
+      case OP_BRANCH_LESSOREQUAL:
+        sp -= 2;
+        pc = (sp[1] <= sp[2]) ? code + *pc : pc + 1;
+        break;
+      case OP_BRANCH_GREATERTHAN:
+        sp -= 2;
+        pc = (sp[1] > sp[2]) ? code + *pc : pc + 1;
+        break;
+      case OP_BRANCH_GREATEROREQUAL:
+        sp -= 2;
+        pc = (sp[1] >= sp[2]) ? code + *pc : pc + 1;
+        break;
+      case OP_JUMP:
+        pc = code + *pc;
+        break;
+      case OP_GOTO:
+        if ((line = find_line (*sp--)) == -1)
+          error = E_INVALID_LINE_NUMBER;
+        else
+          pc = code + this->priv->lines [line].address;
+        break;
+      case OP_CALL:
+        if (gosub_sp == gosub_limit)
+          error = E_TOO_MANY_GOSUBS;
+        else {
+          *gosub_sp++ = pc + 1;
+          pc = code + *pc;
+          if (gosub_sp > gosub_peak)
+            gosub_peak = gosub_sp;
+        }
+        break;
+      case OP_GOSUB:
+        if (gosub_sp == gosub_limit)
+          error = E_TOO_MANY_GOSUBS;
+        else if ((line = find_line (*sp--)) == -1)
+          error = E_INVALID_LINE_NUMBER;
+        else {
+          *gosub_sp++ = pc;
+          pc = code + this->priv->lines [line].address;
+          if (gosub_sp > gosub_peak)
+            gosub_peak = gosub_sp;
+        }
+        break;
+      case OP_RETURN:
+        if (gosub_sp == this->priv->gosub_stack)
+          error = E_RETURN_WITHOUT_GOSUB;
+        else
+          pc = *--gosub_sp;
+        break;
+      case OP_PRINT_STRING:
+        printf ("%s", this->priv->strings [*pc++]);
+        column = 1;
+        break;
+      case OP_PRINT_VALUE:
+        printf ("%d", *sp--);
+        column = 1;
+        break;
+      case OP_PRINT_NEWLINE:
+        printf ("\n");
+        column = 0;
+        break;
+      case OP_INPUT:
+        fflush (stdout);
+        ch = 0;
+        for (count = *pc++; count && ! error; --count)
+          if ((result = input_number (this->priv->input, &value, &ch)) == 1)
+            variables [*pc++] = value;
+          else
+            error = result == EOF ? E_END_OF_INPUT : E_OVERFLOW;
+        break;
+    }
+
+  /* record the statistics */
+  this->priv->gosub_peak = gosub_peak - this->priv->gosub_stack;
+
+  /* report any error against the line that caused it */
+  if (error && pc) {
+    if (column)
+      printf ("\n");
+    this->priv->errors->set_code (this->priv->errors, error, 0,
+      find_address (pc - 1 - code));
+  }
+}
+
+/*
+ * Return the deepest the GOSUB stack has been
+ * params:
+ *   Bytecode*   bytecode   the bytecode object to query
+ * returns:
+ *   int                    the peak number of nested GOSUBs
+ */
+static int get_gosub_peak (Bytecode *bytecode) {
+  return bytecode->priv->gosub_peak;
+}
+
+/*
+ * Choose where INPUT statements read from
+ * params:
+ *   Bytecode*      bytecode   the bytecode object to configure
+ *   InputBuffer*   input      the input buffer, or NULL for stdin
+ */
+static void set_input (Bytecode *bytecode, InputBuffer *input) {
+  bytecode->priv->input = input
+    ? input
+    : bytecode->priv->standard_input;
+}
+
+/*
+ * Destroy the bytecode object
+ * params:
+ *   Bytecode*   bytecode   the doomed bytecode object
+ */
+static void destroy (Bytecode *bytecode) {
+  if (bytecode) {
+    if (bytecode->priv) {
+      free (bytecode->priv->code);
+      free (bytecode->priv->strings);
+      free (bytecode->priv->fixups);
+      if (bytecode->priv->lines)
+        free (bytecode->priv->lines);
+      label_index_destroy (bytecode->priv->labels);
+      if (bytecode->priv->stack)
+        free (bytecode->priv->stack);
+      if (bytecode->priv->gosub_stack)
+        free (bytecode->priv->gosub_stack);
+      input_destroy (bytecode->priv->standard_input);
+      free (bytecode->priv);
+    }
+    free (bytecode);
+  }
+}
+
+
+/*
+ * Constructors
+ */
+
+
+/*
+ * Constructor
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   Bytecode*                    the new bytecode object
+ */
+Bytecode *new_Bytecode (ErrorHandler *errors, LanguageOptions *options) {
+
+  /* allocate memory */
+  this = malloc (sizeof (Bytecode));
+  this->priv = malloc (sizeof (BytecodeData));
+
+  /* initialise methods */
+  this->compile = compile;
+  this->run = run;
+  this->get_gosub_peak = get_gosub_peak;
+  this->set_input = set_input;
+  this->destroy = destroy;
+
+  /* initialise properties */
+  this->priv->code_max = 256;
+  this->priv->code = malloc (this->priv->code_max * sizeof (int));
+  this->priv->code_size = 0;
+  this->priv->string_max = 16;
+  this->priv->strings = malloc (this->priv->string_max * sizeof (char *));
+  this->priv->string_count = 0;
+  this->priv->fixup_max = 16;
+  this->priv->fixups = malloc
+    (this->priv->fixup_max * sizeof (BytecodeFixup));
+  this->priv->fixup_count = 0;
+  this->priv->lines = NULL;
+  this->priv->labels = NULL;
+  this->priv->line_count = 0;
+  this->priv->depth = this->priv->max_depth = 0;
+  this->priv->stack = NULL;
+  this->priv->gosub_stack = NULL;
+  this->priv->gosub_peak = 0;
+  this->priv->standard_input = this->priv->input = input_create (stdin);
+  this->priv->errors = errors;
+  this->priv->options = options;
+
+  /* return the new object */
+  return this;
+}
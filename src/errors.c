@@ -55,7 +55,8 @@ static char *messages[E_LAST] = { /* the error messages */
   "Divide by zero",
   "Overflow",
   "Out of memory",
-  "Too many gosubs"
+  "Too many gosubs",
+  "End of input"
 };
 
 
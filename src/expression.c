@@ -14,6 +14,208 @@
 #include "parser.h"
 #include "expression.h"
 #include "errors.h"
+#include "arena.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* state of an expression being flattened */
+static ExpressionOp *flat_ops; /* the array being filled, or NULL to count */
+static int flat_count; /* number of operations so far */
+static int flat_depth; /* current depth of the evaluation stack */
+static int flat_max_depth; /* deepest the evaluation stack has been */
+
+
+/*
+ * Functions for Flattening Expressions
+ */
+
+
+/*
+ * Add an operation to the expression being flattened
+ * params:
+ *   ExpressionOpClass   op        the operation to add
+ *   int                 operand   its operand, if any
+ *   int                 change    its effect on the stack depth
+ */
+static void flatten_op (ExpressionOpClass op, int operand, int change) {
+  if (flat_ops) {
+    flat_ops [flat_count].op = op;
+    flat_ops [flat_count].operand = operand;
+  }
+  ++flat_count;
+  flat_depth += change;
+  if (flat_depth > flat_max_depth)
+    flat_max_depth = flat_depth;
+}
+
+/* flatten_factor() has a forward reference to flatten_expression() */
+static void flatten_expression (ExpressionNode *expression);
+
+/*
+ * Flatten a factor
+ * params:
+ *   FactorNode*   factor   the factor to flatten
+ */
+static void flatten_factor (FactorNode *factor) {
+  switch (factor->class) {
+    case FACTOR_VARIABLE:
+      flatten_op (EXPRESSION_OP_VARIABLE, factor->data.variable, 1);
+      break;
+    case FACTOR_VALUE:
+      flatten_op (EXPRESSION_OP_VALUE, factor->data.value, 1);
+      break;
+    case FACTOR_EXPRESSION:
+      flatten_expression (factor->data.expression);
+      flatten_op (EXPRESSION_OP_GROUP, 0, 0);
+      break;
+    default:
+      break;
+  }
+  if (factor->sign == SIGN_NEGATIVE)
+    flatten_op (EXPRESSION_OP_NEGATE, 0, 0);
+}
+
+/*
+ * Flatten a term
+ * params:
+ *   TermNode*   term   the term to flatten
+ */
+static void flatten_term (TermNode *term) {
+
+  /* local variables */
+  RightHandFactor *rhfactor; /* pointer to successive rh factor nodes */
+
+  /* flatten the first factor and each one following */
+  flatten_factor (term->factor);
+  for (rhfactor = term->next; rhfactor; rhfactor = rhfactor->next) {
+    flatten_factor (rhfactor->factor);
+    flatten_op (rhfactor->op == TERM_OPERATOR_MULTIPLY
+      ? EXPRESSION_OP_MULTIPLY
+      : EXPRESSION_OP_DIVIDE, 0, -1);
+  }
+}
+
+/*
+ * Flatten an expression
+ * params:
+ *   ExpressionNode*   expression   the expression to flatten
+ */
+static void flatten_expression (ExpressionNode *expression) {
+
+  /* local variables */
+  RightHandTerm *rhterm; /* pointer to successive rh term nodes */
+
+  /* flatten the first term and each one following */
+  flatten_term (expression->term);
+  for (rhterm = expression->next; rhterm; rhterm = rhterm->next) {
+    flatten_term (rhterm->term);
+    flatten_op (rhterm->op == EXPRESSION_OPERATOR_PLUS
+      ? EXPRESSION_OP_ADD
+      : EXPRESSION_OP_SUBTRACT, 0, -1);
+  }
+}
+
+
+/*
+ * Functions for Folding Expressions
+ */
+
+
+/*
+ * Work out the result of an operation on two constants
+ * params:
+ *   ExpressionOpClass   op       the operation to perform
+ *   int                 left     the left-hand operand
+ *   int                 right    the right-hand operand
+ *   int*                result   the result of the operation
+ * returns:
+ *   int                          !0 if the operation can be folded
+ */
+static int fold_constants (ExpressionOpClass op, int left, int right,
+  int *result) {
+
+  /* perform the operation, leaving any errors for run time */
+  switch (op) {
+    case EXPRESSION_OP_ADD: *result = left + right; break;
+    case EXPRESSION_OP_SUBTRACT: *result = left - right; break;
+    case EXPRESSION_OP_MULTIPLY: *result = left * right; break;
+    case EXPRESSION_OP_DIVIDE:
+      if (! right)
+        return 0;
+      *result = left / right;
+      break;
+    default:
+      return 0;
+  }
+  return *result >= -32768 && *result <= 32767;
+}
+
+/*
+ * Fold the binary operation at the end of a partly folded expression
+ * params:
+ *   ExpressionNode*   expression   the expression being folded
+ *   int               count        the number of operations kept so far
+ * returns:
+ *   int                            the number of operations after folding
+ */
+static int fold_binary (ExpressionNode *expression, int count) {
+
+  /* local variables */
+  ExpressionOp *ops; /* the operations of the expression */
+  ExpressionOpClass op; /* the binary operation */
+  int left, /* index of the first operation of the left-hand operand */
+    right, /* index of the first operation of the right-hand operand */
+    result; /* result of an operation on two constants */
+
+  /* find the operands */
+  ops = expression->ops;
+  op = ops [count - 1].op;
+  right = expression_operand_start (expression, count - 2);
+  left = expression_operand_start (expression, right - 1);
+
+  /* two constants can be replaced by their result */
+  if (left == count - 3
+    && ops [left].op == EXPRESSION_OP_VALUE
+    && ops [right].op == EXPRESSION_OP_VALUE) {
+    if (! fold_constants (op, ops [left].operand, ops [right].operand,
+      &result))
+      return count;
+    ops [left].operand = result;
+    return left + 1;
+  }
+
+  /*
+   * A division result is not range checked, so an identity that would
+   * check it (e.g. -32768/-1+0) must stay where it is.
+   */
+
+  /* remove +0, -0, *1 and /1 */
+  if (right == count - 2
+    && ops [right].op == EXPRESSION_OP_VALUE
+    && (op == EXPRESSION_OP_DIVIDE
+      || ops [right - 1].op != EXPRESSION_OP_DIVIDE)
+    && (ops [right].operand == (op == EXPRESSION_OP_ADD
+      || op == EXPRESSION_OP_SUBTRACT ? 0 : 1)))
+    return right;
+
+  /* remove 0+ and 1* */
+  if (left == right - 1
+    && ops [left].op == EXPRESSION_OP_VALUE
+    && ops [count - 2].op != EXPRESSION_OP_DIVIDE
+    && ((op == EXPRESSION_OP_ADD && ops [left].operand == 0)
+      || (op == EXPRESSION_OP_MULTIPLY && ops [left].operand == 1))) {
+    memmove (&ops [left], &ops [right],
+      (count - 1 - right) * sizeof (ExpressionOp));
+    return count - 2;
+  }
+
+  /* nothing could be folded */
+  return count;
+}
 
 
 /*
@@ -32,7 +234,7 @@ FactorNode *factor_create (void) {
   FactorNode *factor; /* the new factor */
 
   /* allocate memory and initialise members */
-  factor = malloc (sizeof (FactorNode));
+  factor = arena_allocate (sizeof (FactorNode));
   factor->class = FACTOR_NONE;
   factor->sign = SIGN_POSITIVE;
 
@@ -40,18 +242,6 @@ FactorNode *factor_create (void) {
   return factor;
 }
 
-/*
- * Destructor for a factor
- * params:
- *   FactorNode*   factor   the doomed factor
- */
-void factor_destroy (FactorNode *factor) {
-  if (factor->class == FACTOR_EXPRESSION && factor->data.expression) {
-    expression_destroy (factor->data.expression);
-  }
-  free (factor);
-}
-
 
 /*
  * Functions for Dealing with Terms
@@ -69,7 +259,7 @@ RightHandFactor *rhfactor_create (void) {
   RightHandFactor *rhfactor; /* the RH factor of a term to create */
 
   /* allocate memory and initialise members */
-  rhfactor = malloc (sizeof (RightHandFactor));
+  rhfactor = arena_allocate (sizeof (RightHandFactor));
   rhfactor->op = TERM_OPERATOR_NONE;
   rhfactor->factor = NULL;
   rhfactor->next = NULL;
@@ -78,19 +268,6 @@ RightHandFactor *rhfactor_create (void) {
   return rhfactor;
 }
 
-/*
- * Recursive destructor for a right-hand factor of a term
- * params:
- *   RightHandFactor*   rhfactor   the doomed RH factor of a term
- */
-void rhfactor_destroy (RightHandFactor *rhfactor) {
-  if (rhfactor->next)
-    rhfactor_destroy (rhfactor->next);
-  if (rhfactor->factor)
-    factor_destroy (rhfactor->factor);
-  free (rhfactor);
-}
-
 /*
  * Constructor for a term
  * returns:
@@ -102,7 +279,7 @@ TermNode *term_create (void) {
   TermNode *term; /* the new term */
 
   /* allocate memory and initialise members */
-  term = malloc (sizeof (TermNode));
+  term = arena_allocate (sizeof (TermNode));
   term->factor = NULL;
   term->next = NULL;
 
@@ -110,23 +287,6 @@ TermNode *term_create (void) {
   return term;
 }
 
-/*
- * Destructor for a term
- * params:
- *   TermNode*   term   the doomed term
- */
-void term_destroy (TermNode *term) {
-
-  /* destroy the consituent parts of the term */
-  if (term->factor)
-    factor_destroy (term->factor);
-  if (term->next)
-    rhfactor_destroy (term->next);
-
-  /* destroy the term itself */
-  free (term);
-}
-
 
 /*
  * Functions for dealing with Expressions
@@ -144,7 +304,7 @@ RightHandTerm *rhterm_create (void) {
   RightHandTerm *rhterm; /* the new RH expression */
 
   /* allocate memory and initialise members */
-  rhterm = malloc (sizeof (RightHandTerm));
+  rhterm = arena_allocate (sizeof (RightHandTerm));
   rhterm->op = EXPRESSION_OPERATOR_NONE;
   rhterm->term = NULL;
   rhterm->next = NULL;
@@ -153,19 +313,6 @@ RightHandTerm *rhterm_create (void) {
   return rhterm;
 }
 
-/*
- * Recursive destructor for a right-hand term of an expression
- * params:
- *   RightHandTerm*   rhterm   the doomed RH expression
- */
-void rhterm_destroy (RightHandTerm *rhterm) {
-  if (rhterm->next)
-    rhterm_destroy (rhterm->next);
-  if (rhterm->term)
-    term_destroy (rhterm->term);
-  free (rhterm);
-}
-
 /*
  * Constructor for an expression
  * returns:
@@ -177,27 +324,120 @@ ExpressionNode *expression_create (void) {
   ExpressionNode *expression; /* the new expression */
 
   /* allocate memory and initialise members */
-  expression = malloc (sizeof (ExpressionNode));
+  expression = arena_allocate (sizeof (ExpressionNode));
   expression->term = NULL;
   expression->next = NULL;
+  expression->ops = NULL;
+  expression->op_count = 0;
+  expression->depth = 0;
 
   /* return the new expression */
   return expression;
 }
 
 /*
- * Destructor for a expression
+ * Flatten an expression into a postfix array of operations
+ * The array is allocated from the currently selected arena.
  * params:
- *   ExpressionNode*   expression   the doomed expression
+ *   ExpressionNode*   expression   the expression to flatten
  */
-void expression_destroy (ExpressionNode *expression) {
+void expression_flatten (ExpressionNode *expression) {
+
+  /* count the operations */
+  flat_ops = NULL;
+  flat_count = flat_depth = flat_max_depth = 0;
+  flatten_expression (expression);
+
+  /* allocate the array and fill it */
+  expression->ops = arena_allocate (flat_count * sizeof (ExpressionOp));
+  expression->op_count = flat_count;
+  expression->depth = flat_max_depth;
+  flat_ops = expression->ops;
+  flat_count = flat_depth = flat_max_depth = 0;
+  flatten_expression (expression);
+  flat_ops = NULL;
+}
 
-  /* destroy the consituent parts of the expression */
-  if (expression->term)
-    term_destroy (expression->term);
-  if (expression->next)
-    rhterm_destroy (expression->next);
+/*
+ * Find the first operation of the operand that ends at a given operation
+ * params:
+ *   ExpressionNode*   expression   the flattened expression
+ *   int               end          index of the operand's last operation
+ * returns:
+ *   int                            index of the operand's first operation
+ */
+int expression_operand_start (ExpressionNode *expression, int end) {
+
+  /* local variables */
+  int needed = 1; /* number of values still to be accounted for */
+
+  /* walk back until the operations produce a single value */
+  while (end >= 0) {
+    switch (expression->ops [end].op) {
+      case EXPRESSION_OP_VALUE:
+      case EXPRESSION_OP_VARIABLE:
+        --needed;
+        break;
+      case EXPRESSION_OP_ADD:
+      case EXPRESSION_OP_SUBTRACT:
+      case EXPRESSION_OP_MULTIPLY:
+      case EXPRESSION_OP_DIVIDE:
+        ++needed;
+        break;
+      default:
+        break;
+    }
+    if (! needed)
+      return end;
+    --end;
+  }
+  return 0;
+}
 
-  /* destroy the expression itself */
-  free (expression);
+/*
+ * Fold the constants and remove the identities in a flattened expression
+ * Anything that would raise an error is left to raise it at run time.
+ * params:
+ *   ExpressionNode*   expression   the expression to fold
+ */
+void expression_fold (ExpressionNode *expression) {
+
+  /* local variables */
+  ExpressionOp *ops; /* the operations of the expression */
+  int from, /* index of the next operation to examine */
+    count = 0; /* number of operations kept */
+
+  /* rewrite the operations in place, folding as we go */
+  ops = expression->ops;
+  for (from = 0; from < expression->op_count; ++from) {
+    ops [count++] = ops [from];
+    switch (ops [count - 1].op) {
+
+      /* negate constants, unless that would overflow */
+      case EXPRESSION_OP_NEGATE:
+        if (ops [count - 2].op == EXPRESSION_OP_VALUE
+          && ops [count - 2].operand != -32768) {
+          ops [count - 2].operand = -ops [count - 2].operand;
+          --count;
+        }
+        break;
+
+      /* a constant needs no brackets */
+      case EXPRESSION_OP_GROUP:
+        if (ops [count - 2].op == EXPRESSION_OP_VALUE)
+          --count;
+        break;
+
+      /* fold binary operations */
+      case EXPRESSION_OP_ADD:
+      case EXPRESSION_OP_SUBTRACT:
+      case EXPRESSION_OP_MULTIPLY:
+      case EXPRESSION_OP_DIVIDE:
+        count = fold_binary (expression, count);
+        break;
+      default:
+        break;
+    }
+  }
+  expression->op_count = count;
 }
@@ -17,6 +17,7 @@
 #include "parser.h"
 #include "options.h"
 #include "generatec.h"
+#include "strbuf.h"
 
 
 /*
@@ -35,11 +36,20 @@ typedef struct {
   unsigned int input_used:1; /* true if we need the input routine */
   unsigned long int vars_used:26; /* true for each variable used */
   CLabel *first_label; /* the start of a list of labels */
-  char *code; /* the main block of generated code */
+  CLabel *last_label; /* the end of the list of labels */
+  int return_points; /* the number of GOSUBs, each with a return point */
+  StringBuffer *code; /* the main block of generated code */
+  StringBuffer *output; /* the complete program being assembled */
   ErrorHandler *errors; /* error handler for compilation */
   LanguageOptions *options; /* the language options for compilation */
 } Private;
 
+/* the opening of the bas_exec function, with its GOSUB stack, which is
+   static so that a large GOSUB limit does not overflow the native stack */
+#define BAS_EXEC_HEAD "void bas_exec (void) {\n" \
+  "static int gosub_stack[GOSUB_LIMIT + 1];\n" \
+  "int label = 0, gosub_sp = 0;\n"
+
 /* convenience variables */
 static CProgram *this; /* the object being worked on */
 static Private *data; /* the private data of the object */
@@ -52,123 +62,67 @@ static LanguageOptions *options; /* the language options */
  */
 
 
-/* factor_output() has a forward reference to output_expression() */
-static char *output_expression (ExpressionNode *expression);
-
 /* output_statement() has a forward reference from output_if() */
-static char *output_statement (StatementNode *statement);
+static void output_statement (StatementNode *statement);
 
 
 /*
- * Level 6 Functions
+ * Level 5 Functions
  */
 
 
 /*
- * Output a factor
+ * Output the operand ending at a given operation of an expression
  * params:
- *   FactorNode*   factor   the factor to output
- * return:
- *   char*                  the text representation of the factor
+ *   StringBuffer*     out          the buffer to append the operand to
+ *   ExpressionNode*   expression   the flattened expression
+ *   int               end          index of the operand's last operation
  */
-static char *output_factor (FactorNode *factor) {
+static void output_operand (StringBuffer *out, ExpressionNode *expression,
+  int end) {
 
   /* local variables */
-  char *factor_text = NULL, /* the text of the whole factor */
-    *factor_buffer = NULL, /* temporary buffer for prepending to factor_text */
-    *expression_text = NULL; /* the text of a subexpression */
-
-  /* work out the main factor text */
-  switch (factor->class) {
-    case FACTOR_VARIABLE:
-      factor_text = malloc (2);
-      sprintf (factor_text, "%c", factor->data.variable + 'a' - 1);
-      data->vars_used |= 1 << (factor->data.variable - 1);
+  ExpressionOp *op; /* the last operation of the operand */
+  char operator_char = 0; /* the operator that joins two operands */
+
+  /* output the operand */
+  op = &expression->ops [end];
+  switch (op->op) {
+    case EXPRESSION_OP_VARIABLE:
+      strbuf_append_char (out, op->operand + 'a' - 1);
+      data->vars_used |= 1 << (op->operand - 1);
+      break;
+    case EXPRESSION_OP_VALUE:
+      if (op->operand < 0)
+        strbuf_append_char (out, '(');
+      strbuf_append_int (out, op->operand);
+      if (op->operand < 0)
+        strbuf_append_char (out, ')');
       break;
-    case FACTOR_VALUE:
-      factor_text = malloc (7);
-      sprintf (factor_text, "%d", factor->data.value);
+    case EXPRESSION_OP_NEGATE:
+      strbuf_append_char (out, '-');
+      output_operand (out, expression, end - 1);
       break;
-    case FACTOR_EXPRESSION:
-      if ((expression_text = output_expression (factor->data.expression))) {
-        factor_text = malloc (strlen (expression_text) + 3);
-        sprintf (factor_text, "(%s)", expression_text);
-        free (expression_text);
-      }
+    case EXPRESSION_OP_GROUP:
+      strbuf_append_char (out, '(');
+      output_operand (out, expression, end - 1);
+      strbuf_append_char (out, ')');
       break;
+    case EXPRESSION_OP_ADD: operator_char = '+'; break;
+    case EXPRESSION_OP_SUBTRACT: operator_char = '-'; break;
+    case EXPRESSION_OP_MULTIPLY: operator_char = '*'; break;
+    case EXPRESSION_OP_DIVIDE: operator_char = '/'; break;
     default:
       errors->set_code (errors, E_INVALID_EXPRESSION, 0, 0);
   }
 
-  /* apply a negative sign, if necessary */
-  if (factor_text && factor->sign == SIGN_NEGATIVE) {
-    factor_buffer = malloc (strlen (factor_text) + 2);
-    sprintf (factor_buffer, "-%s", factor_text);
-    free (factor_text);
-    factor_text = factor_buffer;
-  }
-
-  /* return the final factor representation */
-  return factor_text;
-}
-
-
-/*
- * Level 5 Functions
- */
-
-
-/*
- * Output a term
- * params:
- *   TermNode*   term   the term to output
- * returns:
- *   char*              the text representation of the term
- */
-static char *output_term (TermNode *term) {
-
-  /* local variables */
-  char
-    *term_text = NULL, /* the text of the whole term */
-    *factor_text = NULL, /* the text of each factor */
-    operator_char; /* the operator that joins the righthand factor */
-  RightHandFactor *rhfactor; /* right hand factors of the expression */
-
-  /* begin with the initial factor */
-  if ((term_text = output_factor (term->factor))) {
-    rhfactor = term->next;
-    while (! errors->get_code (errors) && rhfactor) {
-
-      /* ascertain the operator text */
-      switch (rhfactor->op) {
-      case TERM_OPERATOR_MULTIPLY:
-        operator_char = '*';
-        break;
-      case TERM_OPERATOR_DIVIDE:
-        operator_char = '/';
-        break;
-      default:
-        errors->set_code (errors, E_INVALID_EXPRESSION, 0, 0);
-        free (term_text);
-        term_text = NULL;
-      }
-
-      /* get the factor that follows the operator */
-      if (! errors->get_code (errors)
-        && (factor_text = output_factor (rhfactor->factor))) {
-        term_text = realloc (term_text,
-          strlen (term_text) + strlen (factor_text) + 2);
-        sprintf (term_text, "%s%c%s", term_text, operator_char, factor_text);
-        free (factor_text);
-      }
-
-      /* look for another term on the right of the expression */
-      rhfactor = rhfactor->next;
-    }
+  /* join the two operands of a binary operator */
+  if (operator_char) {
+    output_operand (out, expression,
+      expression_operand_start (expression, end - 1) - 1);
+    strbuf_append_char (out, operator_char);
+    output_operand (out, expression, end - 1);
   }
-
-  /* return the expression text */
-  return term_text;
 }
 
 
@@ -178,58 +132,14 @@ static char *output_term (TermNode *term) {
 
 
 /*
- * Output an expression for a program listing
+ * Output an expression
  * params:
+ *   StringBuffer*     out          the buffer to append the expression to
  *   ExpressionNode*   expression   the expression to output
- * returns:
- *   char*                          new string containint the expression text
  */
-static char *output_expression (ExpressionNode *expression) {
-
-  /* local variables */
-  char
-    *expression_text = NULL, /* the text of the whole expression */
-    *term_text = NULL, /* the text of each term */
-    operator_char; /* the operator that joins the righthand term */
-  RightHandTerm *rhterm; /* right hand terms of the expression */
-
-  /* begin with the initial term */
-  if ((expression_text = output_term (expression->term))) {
-    rhterm = expression->next;
-    while (! errors->get_code (errors) && rhterm) {
-
-      /* ascertain the operator text */
-      switch (rhterm->op) {
-      case EXPRESSION_OPERATOR_PLUS:
-        operator_char = '+';
-        break;
-      case EXPRESSION_OPERATOR_MINUS:
-        operator_char = '-';
-        break;
-      default:
-        errors->set_code (errors, E_INVALID_EXPRESSION, 0, 0);
-        free (expression_text);
-        expression_text = NULL;
-      }
-
-      /* get the terms that follow the operators */
-      if (! errors->get_code (errors)
-        && (term_text = output_term (rhterm->term))) {
-        expression_text = realloc (expression_text,
-          strlen (expression_text) + strlen (term_text) + 2);
-        sprintf (expression_text, "%s%c%s", expression_text, operator_char,
-          term_text);
-        free (term_text);
-      }
-
-      /* look for another term on the right of the expression */
-      rhterm = rhterm->next;
-    }
-  }
-
-  /* return the expression text */
-  return expression_text;
-
+static void output_expression (StringBuffer *out,
+  ExpressionNode *expression) {
+  output_operand (out, expression, expression->op_count - 1);
 }
 
 
@@ -242,255 +152,180 @@ static char *output_expression (ExpressionNode *expression) {
  * LET statement output
  * params:
  *   LetStatementNode*   letn   data for the LET statement
- * returns:
- *   char*                      the LET statement text
  */
-static char *output_let (LetStatementNode *letn) {
-
-  /* local variables */
-  char
-    *let_text = NULL, /* the LET text to be assembled */
-    *expression_text = NULL; /* the text of the expression */
-
-  /* assemble the expression */
-  expression_text = output_expression (letn->expression);
-
-  /* assemble the final LET text, if we have an expression */
-  if (expression_text) {
-    let_text = malloc (4 + strlen (expression_text));
-    sprintf (let_text, "%c=%s;", 'a' - 1 + letn->variable, expression_text);
-    free (expression_text);
-    data->vars_used |= 1 << (letn->variable - 1);
-  }
-
-  /* return it */
-  return let_text;
+static void output_let (LetStatementNode *letn) {
+  strbuf_append_char (data->code, 'a' - 1 + letn->variable);
+  strbuf_append_char (data->code, '=');
+  output_expression (data->code, letn->expression);
+  strbuf_append_char (data->code, ';');
+  data->vars_used |= 1 << (letn->variable - 1);
 }
 
 /*
  * IF statement output
  * params:
  *   IfStatementNode*   ifn   data for the IF statement
- * returns:
- *   char*                    the IF statement text
  */
-static char *output_if (IfStatementNode *ifn) {
+static void output_if (IfStatementNode *ifn) {
 
   /* local variables */
-  char
-    *if_text = NULL, /* the LET text to be assembled */
-    *left_text = NULL, /* the text of the left expression */
-    *op_text = NULL, /* the operator text */
-    *right_text = NULL, /* the text of the right expression */
-    *statement_text = NULL; /* the text of the conditional statement */
-
-  /* assemble the expressions and conditional statement */
-  left_text = output_expression (ifn->left);
-  right_text = output_expression (ifn->right);
-  statement_text = output_statement (ifn->statement);
+  char *op_text = ""; /* the operator text */
 
   /* work out the operator text */
-  op_text = malloc (3);
   switch (ifn->op) {
-    case RELOP_EQUAL: strcpy (op_text, "=="); break;
-    case RELOP_UNEQUAL: strcpy (op_text, "!="); break;
-    case RELOP_LESSTHAN: strcpy (op_text, "<"); break;
-    case RELOP_LESSOREQUAL: strcpy (op_text, "<="); break;
-    case RELOP_GREATERTHAN: strcpy (op_text, ">"); break;
-    case RELOP_GREATEROREQUAL: strcpy (op_text, ">="); break;
+    case RELOP_EQUAL: op_text = "=="; break;
+    case RELOP_UNEQUAL: op_text = "!="; break;
+    case RELOP_LESSTHAN: op_text = "<"; break;
+    case RELOP_LESSOREQUAL: op_text = "<="; break;
+    case RELOP_GREATERTHAN: op_text = ">"; break;
+    case RELOP_GREATEROREQUAL: op_text = ">="; break;
   }
 
-  /* assemble the final IF text, if we have everything we need */
-  if (left_text && op_text && right_text && statement_text) {
-    if_text = malloc (4 + strlen (left_text) + strlen (op_text) +
-      strlen (right_text) + 3 + strlen (statement_text) + 2);
-    sprintf (if_text, "if (%s%s%s) {%s}", left_text, op_text, right_text,
-      statement_text);
-  }
-
-  /* free up the temporary bits of memory we've reserved */
-  if (left_text) free (left_text);
-  if (op_text) free (op_text);
-  if (right_text) free (right_text);
-  if (statement_text) free (statement_text);
+  /* output the condition and the conditional statement */
+  strbuf_append (data->code, "if (");
+  output_expression (data->code, ifn->left);
+  strbuf_append (data->code, op_text);
+  output_expression (data->code, ifn->right);
+  strbuf_append (data->code, ") {");
+  output_statement (ifn->statement);
+  strbuf_append_char (data->code, '}');
+}
 
-  /* return it */
-  return if_text;
+/*
+ * Output a direct jump to a line resolved by the linker
+ * params:
+ *   ProgramLineNode*   target   the line to jump to
+ */
+static void output_jump (ProgramLineNode *target) {
+  if (target->label) {
+    strbuf_append (data->code, "goto lbl_");
+    strbuf_append_int (data->code, target->label);
+    strbuf_append_char (data->code, ';');
+  } else
+    strbuf_append (data->code, "goto lbl_start;");
 }
 
 /*
  * GOTO statement output
  * params:
  *   GotoStatementNode*   goton   data for the GOTO statement
- * returns:
- *   char*                        the GOTO statement text
  */
-static char *output_goto (GotoStatementNode *goton) {
+static void output_goto (GotoStatementNode *goton) {
 
-  /* local variables */
-  char
-    *goto_text = NULL, /* the GOTO text to be assembled */
-    *expression_text = NULL; /* the text of the expression */
-
-  /* assemble the expression */
-  expression_text = output_expression (goton->label);
-
-  /* assemble the final LET text, if we have an expression */
-  if (expression_text) {
-    goto_text = malloc (27 + strlen (expression_text));
-    sprintf (goto_text, "label=%s; goto goto_block;", expression_text);
-    free (expression_text);
-  }
+  /* a target resolved by the linker can be reached directly */
+  if (goton->target)
+    output_jump (goton->target);
 
-  /* return it */
-  return goto_text;
+  /* otherwise calculate the label and go via the goto block */
+  else {
+    strbuf_append (data->code, "label=");
+    output_expression (data->code, goton->label);
+    strbuf_append (data->code, "; goto goto_block;");
+  }
 }
 
 /*
  * GOSUB statement output
  * params:
  *   GosubStatementNode*   gosubn   data for the GOSUB statement
- * returns:
- *   char*                        the GOSUB statement text
  */
-static char *output_gosub (GosubStatementNode *gosubn) {
+static void output_gosub (GosubStatementNode *gosubn) {
 
   /* local variables */
-  char
-    *gosub_text = NULL, /* the GOSUB text to be assembled */
-    *expression_text = NULL; /* the text of the expression */
-
-  /* assemble the expression */
-  expression_text = output_expression (gosubn->label);
-
-  /* assemble the final LET text, if we have an expression */
-  if (expression_text) {
-    gosub_text = malloc (12 + strlen (expression_text));
-    sprintf (gosub_text, "bas_exec(%s);", expression_text);
-    free (expression_text);
+  int return_point; /* the number of this GOSUB's return point */
+
+  /* save the return point, checking for stack overflow */
+  return_point = ++data->return_points;
+  strbuf_append (data->code,
+    "if (gosub_sp==GOSUB_LIMIT) exit(E_TOO_MANY_GOSUBS);\n"
+    "gosub_stack[gosub_sp++]=");
+  strbuf_append_int (data->code, return_point);
+  strbuf_append (data->code, "; ");
+
+  /* jump directly to a target resolved by the linker */
+  if (gosubn->target)
+    output_jump (gosubn->target);
+
+  /* otherwise calculate the label and go via the goto block */
+  else {
+    strbuf_append (data->code, "label=");
+    output_expression (data->code, gosubn->label);
+    strbuf_append (data->code, "; goto goto_block;");
   }
 
-  /* return it */
-  return gosub_text;
+  /* mark the return point */
+  strbuf_append (data->code, " ret_");
+  strbuf_append_int (data->code, return_point);
+  strbuf_append (data->code, ":;");
 }
 
 /*
  * END statement output
- * returns:
- *   char*   A new string with the text "END"
  */
-static char *output_end (void) {
-  char *end_text; /* the full text of the END command */
-  end_text = malloc (9);
-  strcpy (end_text, "exit(0);");
-  return end_text;
+static void output_end (void) {
+  strbuf_append (data->code, "exit(0);");
 }
 
 /*
  * RETURN statement output
- * returns:
- *   char*   A new string with the text "RETURN"
  */
-static char *output_return (void) {
-  char *return_text; /* the full text of the RETURN command */
-  return_text = malloc (8);
-  strcpy (return_text, "return;");
-  return return_text;
+static void output_return (void) {
+  strbuf_append (data->code,
+    "if (!gosub_sp) exit(E_RETURN_WITHOUT_GOSUB);\ngoto return_block;");
 }
 
 /*
  * PRINT statement output
  * params:
  *   PrintStatementNode*   printn   data for the PRINT statement
- * returns:
- *   char*                          the PRINT statement text
  */
-static char *output_print (PrintStatementNode *printn) {
+static void output_print (PrintStatementNode *printn) {
 
   /* local variables */
-  char
-    *format_text = NULL, /* the printf format string */
-    *output_list = NULL, /* the printf output list */
-    *output_text = NULL, /* a single output item */
-    *print_text = NULL; /* the PRINT text to be assembled */
+  StringBuffer *output_list; /* the printf output list */
   OutputNode *output; /* the current output item */
 
-  /* initialise format and output text */
-  format_text = malloc (1);
-  *format_text = '\0';
-  output_list = malloc (1);
-  *output_list = '\0';
-
-  /* build the format and output text */
-  if ((output = printn->first)) {
-    do {
-
-      /* format the output item */
-      switch (output->class) {
-        case OUTPUT_STRING:
-          format_text = realloc (format_text,
-            strlen (format_text) + strlen (output->output.string) + 1);
-          strcat (format_text, output->output.string);
-          break;
-        case OUTPUT_EXPRESSION:
-          format_text = realloc (format_text, strlen (format_text) + 3);
-          strcat (format_text, "%d");
-          output_text = output_expression (output->output.expression);
-          output_list = realloc (output_list,
-            strlen (output_list) + 1 + strlen (output_text) + 1);
-          strcat (output_list, ",");
-          strcat (output_list, output_text);
-          free (output_text);
-          break;
-      }
-
-    /* look for the next output item */
-    } while ((output = output->next));
-  }
+  /* output the format string, collecting the output list */
+  output_list = strbuf_create ();
+  strbuf_append (data->code, "printf(\"");
+  for (output = printn->first; output; output = output->next)
+    switch (output->class) {
+      case OUTPUT_STRING:
+        strbuf_append (data->code, output->output.string);
+        break;
+      case OUTPUT_EXPRESSION:
+        strbuf_append (data->code, "%d");
+        strbuf_append_char (output_list, ',');
+        output_expression (output_list, output->output.expression);
+        break;
+    }
 
-  /* assemble the whole print text and return it */
-  print_text = malloc (8 + strlen (format_text) + 3 + strlen (output_list) + 3);
-  sprintf (print_text, "printf(\"%s\\n\"%s);", format_text, output_list);
-  free (format_text);
-  free (output_list);
-  return print_text;
+  /* finish the format string and add the output list */
+  strbuf_append (data->code, "\\n\"");
+  strbuf_append (data->code, output_list->text);
+  strbuf_append (data->code, ");");
+  strbuf_destroy (output_list);
 }
 
 /*
  * INPUT statement output
  * params:
  *   InputStatementNode*   inputn   the input statement node to show
- * returns:
- *   char *                         the text of the INPUT statement
  */
-static char *output_input (InputStatementNode *inputn) {
+static void output_input (InputStatementNode *inputn) {
 
   /* local variables */
-  char
-    *var_text, /* input text for a single variable */
-    *input_text; /* the INPUT text to be assembled */
   VariableListNode *variable; /* the current output item */
 
   /* generate an input line for each variable listed */
-  input_text = malloc (1);
-  *input_text = '\0';
-  if ((variable = inputn->first)) {
-    do {
-      var_text = malloc (18);
-      sprintf (var_text, "%s%c = bas_input();",
-        (variable == inputn->first) ? "" : "\n",
-        variable->variable + 'a' - 1);
-      input_text = realloc (input_text,
-        strlen (input_text) + strlen (var_text) + 1);
-      strcat (input_text, var_text);
-      free (var_text);
-      data->vars_used |= 1 << (variable->variable - 1);
-    } while ((variable = variable->next));
+  for (variable = inputn->first; variable; variable = variable->next) {
+    if (variable != inputn->first)
+      strbuf_append_char (data->code, '\n');
+    strbuf_append_char (data->code, variable->variable + 'a' - 1);
+    strbuf_append (data->code, " = bas_input();");
+    data->vars_used |= 1 << (variable->variable - 1);
   }
   data->input_used = 1;
-
-  /* return the assembled text */
-  return input_text;
 }
 
 
@@ -503,51 +338,139 @@ static char *output_input (InputStatementNode *inputn) {
  * Statement output
  * params:
  *   StatementNode*   statement   the statement to output
- * returns:
- *   char*                        a string containing the statement line
  */
-static char *output_statement (StatementNode *statement) {
-
-  /* local variables */
-  char *output = NULL; /* the text output */
-
-  /* return null output for comments */
-  if (! statement)
-    return NULL;
+static void output_statement (StatementNode *statement) {
 
-  /* build the statement itself */
+  /* output the statement itself */
   switch (statement->class) {
     case STATEMENT_LET:
-      output = output_let (statement->statement.letn);
+      output_let (statement->statement.letn);
       break;
     case STATEMENT_IF:
-      output = output_if (statement->statement.ifn);
+      output_if (statement->statement.ifn);
       break;
     case STATEMENT_GOTO:
-      output = output_goto (statement->statement.goton);
+      output_goto (statement->statement.goton);
       break;
     case STATEMENT_GOSUB:
-      output = output_gosub (statement->statement.gosubn);
+      output_gosub (statement->statement.gosubn);
       break;
     case STATEMENT_RETURN:
-      output = output_return ();
+      output_return ();
       break;
     case STATEMENT_END:
-     output = output_end ();
+     output_end ();
      break;
     case STATEMENT_PRINT:
-      output = output_print (statement->statement.printn);
+      output_print (statement->statement.printn);
       break;
     case STATEMENT_INPUT:
-      output = output_input (statement->statement.inputn);
+      output_input (statement->statement.inputn);
       break;
     default:
-      output = malloc (24);
-      strcpy (output, "Unrecognised statement.");
+      strbuf_append (data->code, "Unrecognised statement.");
+  }
+}
+
+/*
+ * Generate a binary search for the first label at or above the target
+ * The target lies in labels [first..last], or beyond them if last is
+ * the number of labels.
+ * params:
+ *   int*   labels   the sorted labels of the program
+ *   int    count    the number of labels
+ *   int    first    the first label that could be the target
+ *   int    last     the last label that could be the target
+ */
+static void generate_goto_search (int *labels, int count, int first,
+  int last) {
+
+  /* local variables */
+  int middle; /* the label to compare against */
+
+  /* a single candidate needs no comparison */
+  if (first == last) {
+    if (last == count)
+      strbuf_append (data->output, "goto lbl_start;\n");
+    else {
+      strbuf_append (data->output, "goto lbl_");
+      strbuf_append_int (data->output, labels [first]);
+      strbuf_append (data->output, ";\n");
+    }
+  }
+
+  /* otherwise split the candidates in two */
+  else {
+    middle = (first + last) / 2;
+    strbuf_append (data->output, "if (label<=");
+    strbuf_append_int (data->output, labels [middle]);
+    strbuf_append (data->output, ") {\n");
+    generate_goto_search (labels, count, first, middle);
+    strbuf_append (data->output, "} else {\n");
+    generate_goto_search (labels, count, middle + 1, last);
+    strbuf_append (data->output, "}\n");
+  }
+}
+
+/*
+ * Generate the goto block, which finds the line for a computed label
+ */
+static void generate_goto_block (void) {
+
+  /* local variables */
+  CLabel *label; /* label pointer for construction goto block */
+  int *labels, /* the labels in ascending order */
+    count = 0; /* the number of labels */
+
+  /* unnumbered lines can be reached only by their exact label */
+  strbuf_append (data->output, "goto_block:\n");
+  if (options->get_line_numbers (options) == LINE_NUMBERS_OPTIONAL) {
+    strbuf_append (data->output, "switch (label) {\n");
+    for (label = data->first_label; label; label = label->next) {
+      strbuf_append (data->output, "case ");
+      strbuf_append_int (data->output, label->number);
+      strbuf_append (data->output, ": goto lbl_");
+      strbuf_append_int (data->output, label->number);
+      strbuf_append (data->output, ";\n");
+    }
+    strbuf_append (data->output, "}\n");
+  }
+
+  /* otherwise search for the first line at or above the label */
+  else {
+    strbuf_append (data->output, "if (!label) goto lbl_start;\n");
+    for (label = data->first_label; label; label = label->next)
+      ++count;
+    labels = malloc ((count + 1) * sizeof (int));
+    count = 0;
+    for (label = data->first_label; label; label = label->next)
+      labels [count++] = label->number;
+    generate_goto_search (labels, count, 0, count);
+    free (labels);
   }
+  strbuf_append (data->output, "lbl_start:\n");
+}
 
-  /* return the listing line */
-  return output;
+/*
+ * Generate the return block, which resumes after the latest GOSUB
+ */
+static void generate_return_block (void) {
+
+  /* local variables */
+  int return_point; /* return point counter */
+
+  /* dispatch to the return point popped from the GOSUB stack */
+  strbuf_append (data->output, "return_block:\n");
+  strbuf_append (data->output, "switch (gosub_stack[--gosub_sp]) {\n");
+  for (return_point = 1; return_point <= data->return_points;
+    ++return_point) {
+    strbuf_append (data->output, "case ");
+    strbuf_append_int (data->output, return_point);
+    strbuf_append (data->output, ": goto ret_");
+    strbuf_append_int (data->output, return_point);
+    strbuf_append (data->output, ";\n");
+  }
+  strbuf_append (data->output, "}\n");
 }
 
 
@@ -568,44 +491,47 @@ static void generate_line (ProgramLineNode *program_line) {
     *prior_label, /* label before potential insertion point */
     *next_label, /* label after potential insertion point */
     *new_label; /* a label to insert */
-  char
-    label_text[12], /* text of a line label */
-    *statement_text; /* the text of a statement */
 
   /* generate a line label */
   if (program_line->label) {
 
-    /* insert the label into the label list */
-    new_label = malloc (sizeof (CLabel));
-    new_label->number = program_line->label;
-    new_label->next = NULL;
+    /* find where the label belongs, usually at the end of the list */
     prior_label = NULL;
     next_label = data->first_label;
-    while (next_label && next_label->number < new_label->number) {
+    if (data->last_label && data->last_label->number < program_line->label) {
+      prior_label = data->last_label;
+      next_label = NULL;
+    }
+    while (next_label && next_label->number < program_line->label) {
       prior_label = next_label;
       next_label = prior_label->next;
     }
-    new_label->next = next_label;
-    if (prior_label)
-      prior_label->next = new_label;
-    else
-      data->first_label = new_label;
-
-    /* append the label to the code block */
-    sprintf (label_text, "lbl_%d:\n", program_line->label);
-    data->code = realloc (data->code,
-      strlen (data->code) + strlen (label_text) + 1);
-    strcat (data->code, label_text);
+
+    /* a label seen before, e.g. on a run of comments, is not repeated */
+    if (! next_label || next_label->number != program_line->label) {
+
+      /* insert the label into the label list */
+      new_label = malloc (sizeof (CLabel));
+      new_label->number = program_line->label;
+      new_label->next = next_label;
+      if (prior_label)
+        prior_label->next = new_label;
+      else
+        data->first_label = new_label;
+      if (! next_label)
+        data->last_label = new_label;
+
+      /* append the label to the code block */
+      strbuf_append (data->code, "lbl_");
+      strbuf_append_int (data->code, program_line->label);
+      strbuf_append (data->code, ":\n");
+    }
   }
 
-  /* generate the statement, and append it if it is not a comment */
-  statement_text = output_statement (program_line->statement);
-  if (statement_text) {
-    data->code = realloc (data->code,
-      strlen (data->code) + strlen (statement_text) + 2);
-    strcat (data->code, statement_text);
-    strcat (data->code, "\n");
-    free (statement_text);
+  /* generate the statement, if it is not a comment */
+  if (program_line->statement) {
+    output_statement (program_line->statement);
+    strbuf_append_char (data->code, '\n');
   }
 }
 
@@ -615,23 +541,17 @@ static void generate_line (ProgramLineNode *program_line) {
  *   Private*   data   appends headers to the output
  */
 static void generate_includes (void) {
-
-  /* local variables */
-  char
-    include_text[1024], /* the whole include and #define text */
-    define_text[80]; /* a single #define line */
-
-  /* build up includes and defines */
-  strcpy (include_text, "#include <stdio.h>\n");
-  strcat (include_text, "#include <stdlib.h>\n");
-  sprintf (define_text, "#define E_RETURN_WITHOUT_GOSUB %d\n",
-    E_RETURN_WITHOUT_GOSUB);
-  strcat (include_text, define_text);
-
-  /* add the #includes and #defines to the output */
-  this->c_output = realloc (this->c_output, strlen (this->c_output)
-    + strlen (include_text) + 1);
-  strcat (this->c_output, include_text);
+  strbuf_append (data->output, "#include <stdio.h>\n");
+  strbuf_append (data->output, "#include <stdlib.h>\n");
+  strbuf_append (data->output, "#define E_RETURN_WITHOUT_GOSUB ");
+  strbuf_append_int (data->output, E_RETURN_WITHOUT_GOSUB);
+  strbuf_append (data->output, "\n#define E_TOO_MANY_GOSUBS ");
+  strbuf_append_int (data->output, E_TOO_MANY_GOSUBS);
+  strbuf_append (data->output, "\n#define E_END_OF_INPUT ");
+  strbuf_append_int (data->output, E_END_OF_INPUT);
+  strbuf_append (data->output, "\n#define GOSUB_LIMIT ");
+  strbuf_append_int (data->output, options->get_gosub_limit (options));
+  strbuf_append_char (data->output, '\n');
 }
 
 /*
@@ -642,61 +562,58 @@ static void generate_includes (void) {
 static void generate_variables (void) {
 
   /* local variables */
-  int vcount; /* variable counter */
-  char
-    var_text [12], /* individual variable text */
-    declaration[60]; /* declaration text */
-
-  /* build the declaration */
-  *declaration = '\0';
-  for (vcount = 0; vcount < 26; ++vcount) {
+  int
+    vcount, /* variable counter */
+    declared = 0; /* !0 once the declaration is started */
+
+  /* declare each variable used */
+  for (vcount = 0; vcount < 26; ++vcount)
     if (data->vars_used & 1 << vcount) {
-      if (*declaration)
-        sprintf (var_text, ",%c", 'a' + vcount);
-      else
-        sprintf (var_text, "short int %c", 'a' + vcount);
-      strcat (declaration, var_text);
+      strbuf_append (data->output, declared ? "," : "short int ");
+      strbuf_append_char (data->output, 'a' + vcount);
+      declared = 1;
     }
-  }
 
-  /* if there are any variables, add the declaration to the output */
-  if (*declaration) {
-    strcat (declaration, ";\n");
-    this->c_output = realloc (this->c_output, strlen (this->c_output)
-      + strlen (declaration) + 1);
-    strcat (this->c_output, declaration);
-  }
+  /* finish the declaration, if there is one */
+  if (declared)
+    strbuf_append (data->output, ";\n");
 }
 
 /*
  * Generate the bas_input function
+ * Input is read a line at a time into a buffer and the numbers are
+ * taken from there, rather than calling getchar for every character.
+ * The program exits with an error code if the input runs out first.
  * changes:
  *   Private*   data   appends declaration to the output
  */
 static void generate_bas_input (void) {
-
-  /* local variables */
-  char function_text[1024]; /* the entire function */
-
-  /* construct the function text */
-  strcpy (function_text, "short int bas_input (void) {\n");
-  strcat (function_text, "short int ch, sign, value;\n");
-  strcat (function_text, "do {\n");
-  strcat (function_text, "if (ch == '-') sign = -1; else sign = 1;\n");
-  strcat (function_text, "ch = getchar ();\n");
-  strcat (function_text, "} while (ch < '0' || ch > '9');\n");
-  strcat (function_text, "value = 0;\n");
-  strcat (function_text, "do {\n");
-  strcat (function_text, "value = 10 * value + (ch - '0');\n");
-  strcat (function_text, "ch = getchar ();\n");
-  strcat (function_text, "} while (ch >= '0' && ch <= '9');\n");
-  strcat (function_text, "return sign * value;\n");
-  strcat (function_text, "}\n");
-
-  /* add the function text to the output */
-  this->c_output = realloc (this->c_output, strlen (this->c_output)
-    + strlen (function_text) + 1);
-  strcat (this->c_output, function_text);
+  strbuf_append (data->output, "char bas_inbuf[4096];\n");
+  strbuf_append (data->output, "int bas_inpos = 0;\n");
+  strbuf_append (data->output, "int bas_getc (void) {\n");
+  strbuf_append (data->output, "if (! bas_inbuf[bas_inpos]) {\n");
+  strbuf_append (data->output,
+    "if (! fgets (bas_inbuf, sizeof bas_inbuf, stdin)) return EOF;\n");
+  strbuf_append (data->output, "bas_inpos = 0;\n");
+  strbuf_append (data->output, "}\n");
+  strbuf_append (data->output,
+    "return (unsigned char) bas_inbuf[bas_inpos++];\n");
+  strbuf_append (data->output, "}\n");
+  strbuf_append (data->output, "short int bas_input (void) {\n");
+  strbuf_append (data->output, "short int ch = 0, sign, value;\n");
+  strbuf_append (data->output, "fflush (stdout);\n");
+  strbuf_append (data->output, "do {\n");
+  strbuf_append (data->output, "if (ch == '-') sign = -1; else sign = 1;\n");
+  strbuf_append (data->output,
+    "if ((ch = bas_getc ()) == EOF) exit (E_END_OF_INPUT);\n");
+  strbuf_append (data->output, "} while (ch < '0' || ch > '9');\n");
+  strbuf_append (data->output, "value = 0;\n");
+  strbuf_append (data->output, "do {\n");
+  strbuf_append (data->output, "value = 10 * value + (ch - '0');\n");
+  strbuf_append (data->output, "ch = bas_getc ();\n");
+  strbuf_append (data->output, "} while (ch >= '0' && ch <= '9');\n");
+  strbuf_append (data->output, "return sign * value;\n");
+  strbuf_append (data->output, "}\n");
 }
 
 /*
@@ -705,49 +622,12 @@ static void generate_bas_input (void) {
  *   Private*   data   appends declaration to the output
  */
 static void generate_bas_exec (void) {
-
-  /* local variables */
-  char
-    *op, /* comparison operator to use for line numbers */
-    goto_line[80], /* a line in the goto block */
-    *goto_block, /* the goto block */
-    *function_text; /* the complete function text */
-  CLabel *label; /* label pointer for construction goto block */
-
-  /* decide which operator to use for comparison */
-  op = (options->get_line_numbers (options) == LINE_NUMBERS_OPTIONAL)
-    ? "=="
-    : "<=";
-
-  /* create the goto block */
-  goto_block = malloc (128);
-  strcpy (goto_block, "goto_block:\n");
-  strcat (goto_block, "if (!label) goto lbl_start;\n");
-  label = data->first_label;
-  while (label) {
-    sprintf (goto_line, "if (label%s%d) goto lbl_%d;\n",
-      op, label->number, label->number);
-    goto_block = realloc (goto_block,
-      strlen (goto_block) + strlen (goto_line) + 1);
-    strcat (goto_block, goto_line);
-    label = label->next;
-  }
-  goto_block = realloc (goto_block, strlen (goto_block) + 12);
-  strcat (goto_block, "lbl_start:\n");
-
-  /* put the function together */
-  function_text = malloc (28 + strlen (goto_block) + strlen (data->code) + 3);
-  strcpy (function_text, "void bas_exec (int label) {\n");
-  strcat (function_text, goto_block);
-  strcat (function_text, data->code);
-  strcat (function_text, "}\n");
-
-  /* add the function text to the output */
-  this->c_output = realloc (this->c_output, strlen (this->c_output)
-    + strlen (function_text) + 1);
-  strcat (this->c_output, function_text);
-  free (goto_block);
-  free (function_text);
+  strbuf_append (data->output, BAS_EXEC_HEAD);
+  generate_goto_block ();
+  strbuf_append (data->output, data->code->text);
+  strbuf_append (data->output, "exit(0);\n");
+  generate_return_block ();
+  strbuf_append (data->output, "}\n");
 }
 
 /*
@@ -756,20 +636,10 @@ static void generate_bas_exec (void) {
  *   Private*   data   appends declaration to the output
  */
 void generate_main (void) {
-
-  /* local variables */
-  char function_text[1024]; /* the entire function */
-
-  /* construct the function text */
-  strcpy (function_text, "int main (void) {\n");
-  strcat (function_text, "bas_exec (0);\n");
-  strcat (function_text, "exit (E_RETURN_WITHOUT_GOSUB);\n");
-  strcat (function_text, "}\n");
-
-  /* add the function text to the output */
-  this->c_output = realloc (this->c_output, strlen (this->c_output)
-    + strlen (function_text) + 1);
-  strcat (this->c_output, function_text);
+  strbuf_append (data->output, "int main (void) {\n");
+  strbuf_append (data->output, "bas_exec ();\n");
+  strbuf_append (data->output, "return 0;\n");
+  strbuf_append (data->output, "}\n");
 }
 
 
@@ -802,12 +672,18 @@ static void generate (CProgram *c_program, ProgramNode *program) {
   }
 
   /* put the code together */
+  data->output = strbuf_create ();
   generate_includes ();
   generate_variables ();
   if (data->input_used)
     generate_bas_input ();
   generate_bas_exec ();
   generate_main ();
+
+  /* hand the assembled program over as the output */
+  free (this->c_output);
+  this->c_output = strbuf_release (data->output);
+  data->output = NULL;
 }
 
 /*
@@ -832,8 +708,8 @@ static void destroy (CProgram *c_program) {
       next_label = current_label->next;
       free (current_label);
     }
-    if (data->code)
-      free (data->code);
+    strbuf_destroy (data->code);
+    strbuf_destroy (data->output);
     free (data);
   }
 
@@ -872,8 +748,10 @@ CProgram *new_CProgram (ErrorHandler *compiler_errors,
   data->input_used = 0;
   data->vars_used = 0;
   data->first_label = NULL;
-  data->code = malloc (1);
-  *data->code = '\0';
+  data->last_label = NULL;
+  data->return_points = 0;
+  data->code = strbuf_create ();
+  data->output = NULL;
   this->c_output = malloc (1);
   *this->c_output = '\0';
 
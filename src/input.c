@@ -0,0 +1,171 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Input Buffer Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "input.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the size of the blocks read from a stream */
+#define INPUT_BLOCK_SIZE 4096
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Take the next character from the buffer, reading a block if it is empty
+ * A block is read with a single system call, which returns what is
+ * available, so that interactive input need not fill the whole block.
+ * params:
+ *   InputBuffer*   input   the input buffer
+ * returns:
+ *   int                    the character, or EOF at the end of the input
+ */
+static int next_char (InputBuffer *input) {
+  if (input->position == input->length) {
+    if (! input->stream)
+      return EOF;
+    input->position = 0;
+    input->length = read (fileno (input->stream), input->buffer, input->size);
+    if (input->length <= 0) {
+      input->length = 0;
+      return EOF;
+    }
+  }
+  return (unsigned char) input->buffer [input->position++];
+}
+
+
+/*
+ * Public Functions
+ */
+
+
+/*
+ * Create an input buffer that reads blocks from a stream as needed
+ * params:
+ *   FILE*   stream   the stream to read
+ * returns:
+ *   InputBuffer*     the new input buffer
+ */
+InputBuffer *input_create (FILE *stream) {
+  InputBuffer *input; /* the new input buffer */
+  if ((input = malloc (sizeof (InputBuffer)))) {
+    input->stream = stream;
+    input->owned = 0;
+    input->buffer = malloc (INPUT_BLOCK_SIZE);
+    input->length = input->position = 0;
+    input->size = INPUT_BLOCK_SIZE;
+  }
+  return input;
+}
+
+/*
+ * Create an input buffer holding the whole of a prepared input file
+ * A file with no size, such as a pipe, is read in blocks as needed.
+ * params:
+ *   char*   filename   the name of the file to load
+ * returns:
+ *   InputBuffer*       the new input buffer, or NULL if it cannot be read
+ */
+InputBuffer *input_load (char *filename) {
+
+  /* local variables */
+  FILE *file; /* the input file */
+  InputBuffer *input; /* the new input buffer */
+  long size; /* the size of the file */
+
+  /* find the size of the file */
+  if (! (file = fopen (filename, "rb")))
+    return NULL;
+  if (fseek (file, 0, SEEK_END) || (size = ftell (file)) <= 0) {
+
+    /* a pipe or device has no size, so read it in blocks as needed */
+    rewind (file);
+    if ((input = input_create (file)))
+      input->owned = 1;
+    else
+      fclose (file);
+    return input;
+  }
+  rewind (file);
+
+  /* read it in one go */
+  if ((input = malloc (sizeof (InputBuffer)))) {
+    input->stream = NULL;
+    input->owned = 0;
+    input->buffer = malloc (size + 1);
+    input->length = fread (input->buffer, 1, size, file);
+    input->position = 0;
+    input->size = size + 1;
+  }
+  fclose (file);
+  return input;
+}
+
+/*
+ * Read a number for an INPUT statement
+ * params:
+ *   InputBuffer*   input   the input buffer
+ *   int*           value   the place to store the number
+ *   int*           ch      the last character read, 0 at first
+ * returns:
+ *   int                    1 if the number was in range, 0 if it was not,
+ *                          or EOF if the input ran out first
+ */
+int input_number (InputBuffer *input, int *value, int *ch) {
+
+  /* local variables */
+  int sign = 1; /* the default sign */
+
+  /* skip to the first digit, noting any preceding minus sign */
+  do {
+    if (*ch == '-') sign = -1; else sign = 1;
+    if ((*ch = next_char (input)) == EOF)
+      return EOF;
+  } while (*ch < '0' || *ch > '9');
+
+  /* read the digits */
+  *value = 0;
+  do {
+    *value = 10 * *value + (*ch - '0');
+    if (*value * sign < -32768 || *value * sign > 32767)
+      return 0;
+    *ch = next_char (input);
+  } while (*ch >= '0' && *ch <= '9');
+
+  /* apply the sign */
+  *value *= sign;
+  return 1;
+}
+
+/*
+ * Destroy an input buffer, leaving its stream open unless it loaded it
+ * params:
+ *   InputBuffer*   input   the doomed input buffer
+ */
+void input_destroy (InputBuffer *input) {
+  if (input) {
+    if (input->owned)
+      fclose (input->stream);
+    if (input->buffer)
+      free (input->buffer);
+    free (input);
+  }
+}
@@ -11,14 +11,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "interpret.h"
 #include "errors.h"
 #include "options.h"
 #include "statement.h"
+#include "labels.h"
+#include "profile.h"
+#include "input.h"
+#include "jit.h"
 
 
 /* forward declarations */
-static int interpret_expression (ExpressionNode *expression);
 static void interpret_statement (StatementNode *statement);
 
 
@@ -26,21 +30,41 @@ static void interpret_statement (StatementNode *statement);
  * Data Definitions
  */
 
-/* The GOSUB Stack */
-typedef struct gosub_stack_node GosubStackNode;
-typedef struct gosub_stack_node {
-  ProgramLineNode *program_line; /* the line following the GOSUB */
-  GosubStackNode *next; /* stack node for the previous GOSUB */
-} GosubStackNode;
+
+/* initial size of the PRINT output buffer */
+#define OUTPUT_BUFFER_SIZE 4096
+
+/* backward branches to a line before the loop it heads is traced */
+#define TRACE_THRESHOLD 100
+
+/* the most lines a trace may hold */
+#define TRACE_LENGTH 64
 
 /* private data */
 typedef struct interpreter_data {
   ProgramNode *program; /* the program to interpret */
+  LabelIndex *labels; /* index of the program's line labels */
   ProgramLineNode *line; /* current line we're executing */
-  GosubStackNode *gosub_stack; /* the top of the GOSUB stack */
+  ProgramLineNode **gosub_stack; /* lines following each active GOSUB */
   int gosub_stack_size; /* number of entries on the GOSUB stack */
+  int gosub_stack_limit; /* number of entries the GOSUB stack can hold */
+  int gosub_stack_peak; /* highest number of entries on the GOSUB stack */
   int variables [26]; /* the numeric variables */
+  int *stack; /* the expression evaluation stack */
+  int stack_size; /* number of entries the evaluation stack can hold */
   int stopped; /* set to 1 when an END is encountered */
+  ErrorCode error; /* the runtime error raised, or E_NONE */
+  Profile *profile; /* the profile to record, if profiling */
+  int tracing; /* !0 to trace hot loops */
+  JIT **traces; /* the compiled trace headed by each source line */
+  int *hotness; /* backward branches to each source line, -1 if untraced */
+  int condition; /* the outcome of the last IF, for recording traces */
+  char *output; /* PRINT output not yet passed to stdout */
+  int output_length; /* number of characters in the output buffer */
+  int output_size; /* number of characters the output buffer can hold */
+  FlushPolicy flush_policy; /* when the output buffer is emptied */
+  InputBuffer *input; /* where INPUT statements read from */
+  InputBuffer *standard_input; /* the buffer for reading stdin */
   ErrorHandler *errors; /* the error handler */
   LanguageOptions *options; /* the language options */
 } InterpreterData;
@@ -55,129 +79,163 @@ static Interpreter *this; /* the object we are working with */
 
 
 /*
- * Evaluate a factor for the interpreter
+ * Raise a runtime error against the current line
+ * The error is kept in the interpreter, where the run loop can test it
+ * cheaply, as well as being passed to the error handler.
  * params:
- *   FactorNode*   factor   the factor to evaluate
+ *   ErrorCode   code   the error to raise
  */
-static int interpret_factor (FactorNode *factor) {
-
-  /* local variables */
-  int result_store = 0; /* result of factor evaluation */
-
-  /* check factor class */
-  switch (factor->class) {
-
-    /* a regular variable */
-    case FACTOR_VARIABLE:
-      result_store = this->priv->variables [factor->data.variable - 1]
-        * (factor->sign == SIGN_POSITIVE ? 1 : -1);
-      break;
-
-    /* an integer constant */
-    case FACTOR_VALUE:
-      result_store = factor->data.value
-        * (factor->sign == SIGN_POSITIVE ? 1 : -1);
-      break;
+static void raise_error (ErrorCode code) {
+  this->priv->error = code;
+  this->priv->errors->set_code
+    (this->priv->errors, code, 0, this->priv->line->label);
+}
 
-    /* an expression */
-    case FACTOR_EXPRESSION:
-      result_store = interpret_expression (factor->data.expression)
-        * (factor->sign == SIGN_POSITIVE ? 1 : -1);
-      break;
+/*
+ * Pass the buffered output on to stdout and flush it
+ */
+static void flush_output (void) {
+  if (this->priv->output_length)
+    fwrite (this->priv->output, 1, this->priv->output_length, stdout);
+  this->priv->output_length = 0;
+  fflush (stdout);
+}
 
-    /* this only happens if the parser has failed in its duty */
-    default:
-      this->priv->errors->set_code
-        (this->priv->errors, E_INVALID_EXPRESSION, 0, this->priv->line->label);
+/*
+ * Make room in the output buffer for more characters
+ * The buffer is emptied when full, unless output is held until exit,
+ * and grows when what is to be added would not fit even when empty.
+ * params:
+ *   int   length   the number of characters to be added
+ */
+static void reserve_output (int length) {
+  if (this->priv->output_length + length <= this->priv->output_size)
+    return;
+  if (this->priv->flush_policy != FLUSH_EXIT && this->priv->output_length) {
+    fwrite (this->priv->output, 1, this->priv->output_length, stdout);
+    this->priv->output_length = 0;
   }
+  while (this->priv->output_length + length > this->priv->output_size)
+    this->priv->output_size *= 2;
+  this->priv->output = realloc (this->priv->output, this->priv->output_size);
+}
 
-  /* check the result and return it*/
-  if (result_store < -32768 || result_store > 32767)
-    this->priv->errors->set_code
-      (this->priv->errors, E_OVERFLOW, 0, this->priv->line->label);
-  return result_store;
+/*
+ * Add a string to the output buffer
+ * params:
+ *   char*   string   the string to output
+ */
+static void output_string (char *string) {
+  int length; /* length of the string */
+  length = strlen (string);
+  reserve_output (length);
+  memcpy (this->priv->output + this->priv->output_length, string, length);
+  this->priv->output_length += length;
 }
 
 /*
- * Evaluate a term for the interpreter
+ * Add a number to the output buffer
  * params:
- *   TermNode*   term   the term to evaluate
+ *   int   value   the number to output
  */
-static int interpret_term (TermNode *term) {
+static void output_number (int value) {
 
   /* local variables */
-  int result_store; /* the partial evaluation */
-  RightHandFactor *rhfactor; /* pointer to successive rh factor nodes */
-  int divisor; /* used to check for division by 0 before attempting */
-
-  /* calculate the first factor result */
-  result_store = interpret_factor (term->factor);
-  rhfactor = term->next;
-
-  /* adjust store according to successive rh factors */
-  while (rhfactor && ! this->priv->errors->get_code (this->priv->errors)) {
-    switch (rhfactor->op) {
-      case TERM_OPERATOR_MULTIPLY:
-        result_store *= interpret_factor (rhfactor->factor);
-	if (result_store < -32768 || result_store > 32767)
-	  this->priv->errors->set_code
-            (this->priv->errors, E_OVERFLOW, 0, this->priv->line->label);
-        break;
-      case TERM_OPERATOR_DIVIDE:
-        if ((divisor = interpret_factor (rhfactor->factor)))
-          result_store /= divisor;
-        else
-          this->priv->errors->set_code
-            (this->priv->errors, E_DIVIDE_BY_ZERO, 0, this->priv->line->label);
-        break;
-      default:
-        break;
-    }
-    rhfactor = rhfactor->next;
-  }
-
-  /* return the result */
-  return result_store;
+  char digits [12], /* the digits in reverse order */
+    *output; /* where the next character is output */
+  unsigned int magnitude; /* the absolute value of the number */
+  int count = 0; /* number of digits */
+
+  /* extract the digits, least significant first */
+  magnitude = (value < 0) ? - (unsigned int) value : (unsigned int) value;
+  do {
+    digits [count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+
+  /* copy the sign and the digits into the buffer */
+  reserve_output (count + 1);
+  output = this->priv->output + this->priv->output_length;
+  if (value < 0)
+    *output++ = '-';
+  while (count)
+    *output++ = digits [--count];
+  this->priv->output_length = output - this->priv->output;
 }
 
 /*
- * Evaluate an expression for the interpreter
+ * Evaluate a flattened expression for the interpreter
  * params:
  *   ExpressionNode*   expression   the expression to evaluate
+ * returns:
+ *   int                            the value of the expression
  */
 static int interpret_expression (ExpressionNode *expression) {
 
   /* local variables */
-  int result_store; /* the partial evaluation */
-  RightHandTerm *rhterm; /* pointer to successive rh term nodes */
-
-  /* calculate the first term result */
-  result_store = interpret_term (expression->term);
-  rhterm = expression->next;
-
-  /* adjust store according to successive rh terms */
-  while (rhterm && ! this->priv->errors->get_code (this->priv->errors)) {
-    switch (rhterm->op) {
-      case EXPRESSION_OPERATOR_PLUS:
-        result_store += interpret_term (rhterm->term);
-	if (result_store < -32768 || result_store > 32767)
-	  this->priv->errors->set_code
-            (this->priv->errors, E_OVERFLOW, 0, this->priv->line->label);
+  ExpressionOp *op, /* the operation being performed */
+    *end; /* the end of the expression's operations */
+  int *sp, /* the top of the evaluation stack */
+    check; /* !0 if the operation's result needs a range check */
+
+  /* make sure the evaluation stack is deep enough */
+  if (expression->depth > this->priv->stack_size) {
+    this->priv->stack_size = expression->depth;
+    this->priv->stack = realloc (this->priv->stack,
+      this->priv->stack_size * sizeof (int));
+  }
+
+  /* perform each operation until an error occurs */
+  sp = this->priv->stack - 1;
+  end = expression->ops + expression->op_count;
+  for (op = expression->ops; op < end; ++op) {
+    check = 1;
+    switch (op->op) {
+      case EXPRESSION_OP_VALUE:
+        *++sp = op->operand;
+        check = 0;
         break;
-      case EXPRESSION_OPERATOR_MINUS:
-        result_store -= interpret_term (rhterm->term);
-	if (result_store < -32768 || result_store > 32767)
-	  this->priv->errors->set_code
-            (this->priv->errors, E_OVERFLOW, 0, this->priv->line->label);
+      case EXPRESSION_OP_VARIABLE:
+        *++sp = this->priv->variables [op->operand - 1];
         break;
-      default:
+      case EXPRESSION_OP_NEGATE:
+        *sp = -*sp;
         break;
+      case EXPRESSION_OP_GROUP:
+        break;
+      case EXPRESSION_OP_ADD:
+        --sp;
+        sp[0] += sp[1];
+        break;
+      case EXPRESSION_OP_SUBTRACT:
+        --sp;
+        sp[0] -= sp[1];
+        break;
+      case EXPRESSION_OP_MULTIPLY:
+        --sp;
+        sp[0] *= sp[1];
+        break;
+      case EXPRESSION_OP_DIVIDE:
+        --sp;
+        check = 0;
+        if (! sp[1]) {
+          raise_error (E_DIVIDE_BY_ZERO);
+          return sp[0];
+        }
+        sp[0] /= sp[1];
+        break;
+      default:
+        raise_error (E_INVALID_EXPRESSION);
+        return 0;
+    }
+    if (check && (*sp < -32768 || *sp > 32767)) {
+      raise_error (E_OVERFLOW);
+      return *sp;
     }
-    rhterm = rhterm->next;
   }
 
   /* return the result */
-  return result_store;
+  return *sp;
 }
 
 /*
@@ -188,24 +246,14 @@ static int interpret_expression (ExpressionNode *expression) {
 static ProgramLineNode *find_label (int jump_label) {
 
   /* local variables */
-  ProgramLineNode
-    *ptr, /* a line we're currently looking at */
-    *found = NULL; /* the line if found */
-
-  /* do the search */
-  for (ptr = this->priv->program->first; ptr && ! found; ptr = ptr->next)
-    if (ptr->label == jump_label)
-      found = ptr;
-    else if (ptr->label >= jump_label
-      && this->priv->options->get_line_numbers (this->priv->options)
-        != LINE_NUMBERS_OPTIONAL)
-      found = ptr;
+  int line; /* index of the line found */
 
-  /* check for errors and return what was found */
-  if (! found)
-    this->priv->errors->set_code
-      (this->priv->errors, E_INVALID_LINE_NUMBER, 0, this->priv->line->label);
-  return found;
+  /* look up the label, and check for errors */
+  if ((line = label_index_find (this->priv->labels, jump_label)) == -1) {
+    raise_error (E_INVALID_LINE_NUMBER);
+    return NULL;
+  }
+  return this->priv->labels->lines [line];
 }
 
 
@@ -248,9 +296,13 @@ void interpret_if_statement (IfStatementNode *ifn) {
     right, /* result of the right-hand expression */
     comparison; /* result of the comparison between the two */
 
-  /* get the expressions */
+  /* get the expressions, stopping at the first error */
   left = interpret_expression (ifn->left);
+  if (this->priv->error)
+    return;
   right = interpret_expression (ifn->right);
+  if (this->priv->error)
+    return;
 
   /* make the comparison */
   switch (ifn->op) {
@@ -263,7 +315,8 @@ void interpret_if_statement (IfStatementNode *ifn) {
   }
 
   /* perform the conditional statement */
-  if (comparison && ! this->priv->errors->get_code (this->priv->errors))
+  this->priv->condition = comparison;
+  if (comparison && ! this->priv->error)
     interpret_statement (ifn->statement);
   else
     this->priv->line = this->priv->line->next;
@@ -276,11 +329,81 @@ void interpret_if_statement (IfStatementNode *ifn) {
  */
 void interpret_goto_statement (GotoStatementNode *goton) {
   int label; /* the line label to go to */
+  if (goton->target) {
+    this->priv->line = goton->target;
+    return;
+  }
   label = interpret_expression (goton->label);
-  if (! this->priv->errors->get_code (this->priv->errors))
+  if (! this->priv->error)
     this->priv->line = find_label (label);
 }
 
+/*
+ * Interpret a fused step statement, LET variable=variable+operand
+ * params:
+ *   StepStatementNode*   stepn   the step statement details
+ */
+void interpret_step_statement (StepStatementNode *stepn) {
+
+  /* local variables */
+  int *variable, /* the variable stepped */
+    operand; /* the value it is stepped by */
+
+  /* step the variable, checking the range as LET would */
+  variable = &this->priv->variables [stepn->variable - 1];
+  operand = (stepn->operand.op == EXPRESSION_OP_VALUE)
+    ? stepn->operand.operand
+    : this->priv->variables [stepn->operand.operand - 1];
+  if (*variable < -32768 || *variable > 32767
+    || operand < -32768 || operand > 32767) {
+    raise_error (E_OVERFLOW);
+    return;
+  }
+  *variable = stepn->subtract ? *variable - operand : *variable + operand;
+  if (*variable < -32768 || *variable > 32767)
+    raise_error (E_OVERFLOW);
+  this->priv->line = this->priv->line->next;
+}
+
+/*
+ * Interpret a fused IF-GOTO statement
+ * params:
+ *   IfGotoStatementNode*   ifgoton   the IF-GOTO statement details
+ */
+void interpret_if_goto_statement (IfGotoStatementNode *ifgoton) {
+
+  /* local variables */
+  int
+    left, /* the left-hand value */
+    right, /* the right-hand value */
+    comparison; /* result of the comparison between the two */
+
+  /* get the values */
+  left = (ifgoton->left.op == EXPRESSION_OP_VALUE)
+    ? ifgoton->left.operand
+    : this->priv->variables [ifgoton->left.operand - 1];
+  right = (ifgoton->right.op == EXPRESSION_OP_VALUE)
+    ? ifgoton->right.operand
+    : this->priv->variables [ifgoton->right.operand - 1];
+  if (left < -32768 || left > 32767 || right < -32768 || right > 32767) {
+    raise_error (E_OVERFLOW);
+    return;
+  }
+
+  /* make the comparison and go to the line if it holds */
+  switch (ifgoton->op) {
+    case RELOP_EQUAL: comparison = (left == right); break;
+    case RELOP_UNEQUAL: comparison = (left != right); break;
+    case RELOP_LESSTHAN: comparison = (left < right); break;
+    case RELOP_LESSOREQUAL: comparison = (left <= right); break;
+    case RELOP_GREATERTHAN: comparison = (left > right); break;
+    case RELOP_GREATEROREQUAL: comparison = (left >= right); break;
+    default: comparison = 0;
+  }
+  this->priv->condition = comparison;
+  this->priv->line = comparison ? ifgoton->target : this->priv->line->next;
+}
+
 /*
  * Interpret a GOSUB statement
  * params:
@@ -289,25 +412,26 @@ void interpret_goto_statement (GotoStatementNode *goton) {
 void interpret_gosub_statement (GosubStatementNode *gosubn) {
 
   /* local variables */
-  GosubStackNode *gosub_node; /* indicates the program line to return to */
   int label; /* the line label to go to */
 
-  /* create the new node on the GOSUB stack */
-  if (this->priv->gosub_stack_size < this->priv->options->get_gosub_limit
-    (this->priv->options)) {
-    gosub_node = malloc (sizeof (GosubStackNode));
-    gosub_node->program_line = this->priv->line->next;
-    gosub_node->next = this->priv->gosub_stack;
-    this->priv->gosub_stack = gosub_node;
-    ++this->priv->gosub_stack_size;
+  /* push the line following onto the GOSUB stack */
+  if (this->priv->gosub_stack_size < this->priv->gosub_stack_limit) {
+    this->priv->gosub_stack [this->priv->gosub_stack_size++]
+      = this->priv->line->next;
+    if (this->priv->gosub_stack_size > this->priv->gosub_stack_peak)
+      this->priv->gosub_stack_peak = this->priv->gosub_stack_size;
   } else
-    this->priv->errors->set_code (this->priv->errors,
-      E_TOO_MANY_GOSUBS, 0, this->priv->line->label);
+    raise_error (E_TOO_MANY_GOSUBS);
   
   /* branch to the subroutine requested */
-  if (! this->priv->errors->get_code (this->priv->errors))
+  if (gosubn->target) {
+    if (! this->priv->error)
+      this->priv->line = gosubn->target;
+    return;
+  }
+  if (! this->priv->error)
     label = interpret_expression (gosubn->label);
-  if (! this->priv->errors->get_code (this->priv->errors))
+  if (! this->priv->error)
     this->priv->line = find_label (label);
 }
 
@@ -316,22 +440,14 @@ void interpret_gosub_statement (GosubStatementNode *gosubn) {
  */
 void interpret_return_statement (void) {
 
-  /* local variables */
-  GosubStackNode *gosub_node; /* node popped off the GOSUB stack */
-
   /* return to the statement following the most recent GOSUB */
-  if (this->priv->gosub_stack) {
-    this->priv->line = this->priv->gosub_stack->program_line;
-    gosub_node = this->priv->gosub_stack;
-    this->priv->gosub_stack = this->priv->gosub_stack->next;
-    free (gosub_node);
-    --this->priv->gosub_stack_size;
-  }
+  if (this->priv->gosub_stack_size)
+    this->priv->line
+      = this->priv->gosub_stack [--this->priv->gosub_stack_size];
 
   /* no GOSUBs led here, so raise an error */
   else
-    this->priv->errors->set_code
-      (this->priv->errors, E_RETURN_WITHOUT_GOSUB, 0, this->priv->line->label);
+    raise_error (E_RETURN_WITHOUT_GOSUB);
 }
 
 /*
@@ -352,23 +468,27 @@ void interpret_print_statement (PrintStatementNode *printn) {
   while (outn) {
     switch (outn->class) {
       case OUTPUT_STRING:
-        printf ("%s", outn->output.string);
+        output_string (outn->output.string);
         ++items;
         break;
       case OUTPUT_EXPRESSION:
         result = interpret_expression (outn->output.expression);
-        if (! this->priv->errors->get_code (this->priv->errors)) {
-          printf ("%d", result);
+        if (! this->priv->error) {
+          output_number (result);
           ++items;
         }
         break;
     }
-    outn = outn->next;
+    outn = this->priv->error ? NULL : outn->next;
   }
 
   /* print the linefeed */
-  if (items)
-    printf ("\n");
+  if (items) {
+    reserve_output (1);
+    this->priv->output [this->priv->output_length++] = '\n';
+    if (this->priv->flush_policy == FLUSH_LINE)
+      flush_output ();
+  }
   this->priv->line = this->priv->line->next;
 }
 
@@ -383,28 +503,20 @@ void interpret_input_statement (InputStatementNode *inputn) {
   VariableListNode *variable; /* current variable to input */
   int
     value, /* value input from the user */
-    sign = 1, /* the default sign */
-    ch = 0; /* character from the input stream */
+    ch = 0, /* character from the input stream */
+    result; /* the result of reading a number */
+
+  /* make sure any prompt has been seen */
+  flush_output ();
 
   /* input each of the variables */
-  variable = inputn->first;
-  while (variable) {
-    do {
-      if (ch == '-') sign = -1; else sign = 1;
-      ch = getchar ();
-    } while (ch < '0' || ch > '9');
-    value = 0;
-    do {
-      value = 10 * value + (ch - '0');
-      if (value * sign < -32768 || value * sign > 32767)
-        this->priv->errors->set_code
-          (this->priv->errors, E_OVERFLOW, 0, this->priv->line->label);
-      ch = getchar ();
-    } while (ch >= '0' && ch <= '9'
-      && ! this->priv->errors->get_code (this->priv->errors));
-    this->priv->variables [variable->variable - 1] = sign * value;
-    variable = variable->next;
-  }
+  for (variable = inputn->first; variable; variable = variable->next)
+    if ((result = input_number (this->priv->input, &value, &ch)) == 1)
+      this->priv->variables [variable->variable - 1] = value;
+    else {
+      raise_error (result == EOF ? E_END_OF_INPUT : E_OVERFLOW);
+      return;
+    }
 
   /* advance to the next statement when done */
   this->priv->line = this->priv->line->next;
@@ -452,22 +564,262 @@ void interpret_statement (StatementNode *statement) {
     case STATEMENT_INPUT:
       interpret_input_statement (statement->statement.inputn);
       break;
+    case STATEMENT_STEP:
+      interpret_step_statement (statement->statement.stepn);
+      break;
+    case STATEMENT_IF_GOTO:
+      interpret_if_goto_statement (statement->statement.ifgoton);
+      break;
     default:
+      flush_output ();
       printf ("Statement type %d not implemented.\n", statement->class);
   }
 }
 
+/*
+ * Determine whether a statement can be part of a trace
+ * A trace records one outcome for each line, so an IF may not hold another
+ * IF, nor a fused IF ... GOTO, whose outcome would be taken for its own.
+ * params:
+ *   StatementNode*   statement   the statement to check
+ * returns:
+ *   int                          !0 if the statement can be traced
+ */
+static int traceable (StatementNode *statement) {
+  if (! statement)
+    return 1;
+  switch (statement->class) {
+    case STATEMENT_LET:
+    case STATEMENT_STEP:
+    case STATEMENT_IF_GOTO:
+      return 1;
+    case STATEMENT_GOTO:
+      return statement->statement.goton->target != NULL;
+    case STATEMENT_IF:
+      return statement->statement.ifn->statement
+        && statement->statement.ifn->statement->class != STATEMENT_IF
+        && statement->statement.ifn->statement->class != STATEMENT_IF_GOTO
+        && traceable (statement->statement.ifn->statement);
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Record one pass around a hot loop, and compile it if it can be traced
+ * The loop is interpreted as usual while it is recorded. Recording stops
+ * at any statement that cannot be traced, or that revisits a line, since
+ * that marks an inner loop that can be traced in its own right.
+ * params:
+ *   ProgramLineNode*   head   the first line of the loop
+ */
+static void record_trace (ProgramLineNode *head) {
+
+  /* local variables */
+  ProgramLineNode *lines [TRACE_LENGTH]; /* the lines executed */
+  int taken [TRACE_LENGTH], /* the outcome of each IF */
+    count = 0, /* the number of lines recorded */
+    step; /* step counter */
+  JIT *trace; /* the compiler for the trace */
+
+  /* interpret the loop once, recording each line until the head recurs */
+  this->priv->hotness [head->source_line] = -1;
+  do {
+    if (count == TRACE_LENGTH
+      || ! traceable (this->priv->line->statement))
+      return;
+    for (step = 0; step < count; ++step)
+      if (lines [step] == this->priv->line)
+        return;
+    lines [count] = this->priv->line;
+    this->priv->condition = 0;
+    interpret_statement (this->priv->line->statement);
+    taken [count++] = this->priv->condition;
+  } while (this->priv->line != head
+    && this->priv->line
+    && ! this->priv->error);
+
+  /* compile the trace if the loop was completed */
+  if (this->priv->line == head
+    && ! this->priv->error
+    && (trace = new_JIT (this->priv->errors, this->priv->options))) {
+    trace->compile_trace (trace, lines, taken, count);
+    this->priv->traces [head->source_line] = trace;
+  }
+}
+
+/*
+ * Count a backward branch, running or recording a trace of its loop
+ */
+static void trace_branch (void) {
+  ProgramLineNode *head; /* the line branched to */
+  JIT *trace; /* the trace headed by that line */
+  head = this->priv->line;
+  if ((trace = this->priv->traces [head->source_line]))
+    this->priv->line = trace->run_trace (trace, this->priv->variables);
+  else if (this->priv->hotness [head->source_line] >= 0
+    && ++this->priv->hotness [head->source_line] == TRACE_THRESHOLD)
+    record_trace (head);
+}
+
+/* count a jump from a line if it is a backward branch and tracing is on */
+#define TRACE_BRANCH(from) \
+  if (this->priv->traces \
+    && this->priv->line \
+    && this->priv->line->source_line <= (from)->source_line \
+    && ! this->priv->error) \
+    trace_branch ()
+
+#ifdef __GNUC__
+
+/*
+ * Interpret program starting from a particular line, by threaded dispatch
+ * The handler for each line is resolved before the run starts, and each
+ * handler jumps straight to the next line's handler, so there is no
+ * single central branch for the processor to mispredict.
+ * params:
+ *   ProgramLineNode*   program_line   the starting line
+ */
+static void interpret_program_from (ProgramLineNode *program_line) {
+
+  /* local variables */
+  static void *classes [] = { /* the handler for each statement class */
+    &&do_none, &&do_let, &&do_if, &&do_goto, &&do_gosub,
+    &&do_return, &&do_end, &&do_print, &&do_input, &&do_step, &&do_if_goto
+  };
+  void **handlers; /* the handler for each source line */
+  ProgramLineNode *line; /* line counter, and the line branched from */
+  int count, /* line counter */
+    size = 0; /* the number of handlers */
+
+  /* resolve the handler for each line, indexed by its source line */
+  for (count = 0; count < this->priv->labels->line_count; ++count)
+    if (this->priv->labels->lines [count]->source_line >= size)
+      size = this->priv->labels->lines [count]->source_line + 1;
+  handlers = malloc ((size + 1) * sizeof (void *));
+  for (count = 0; count < this->priv->labels->line_count; ++count) {
+    line = this->priv->labels->lines [count];
+    handlers [line->source_line] = line->statement
+      ? classes [line->statement->class]
+      : &&do_comment;
+  }
+
+  /* go to the handler for the current line, if there is one to run */
+#define DISPATCH \
+  if (! this->priv->line || this->priv->error) \
+    goto finish; \
+  goto *handlers [this->priv->line->source_line]
+
+  /* run the handlers */
+  this->priv->line = program_line;
+  DISPATCH;
+  do_comment:
+    this->priv->line = this->priv->line->next;
+    DISPATCH;
+  do_none:
+    DISPATCH;
+  do_let:
+    interpret_let_statement (this->priv->line->statement->statement.letn);
+    DISPATCH;
+  do_if:
+    line = this->priv->line;
+    interpret_if_statement (line->statement->statement.ifn);
+    if (this->priv->stopped)
+      goto finish;
+    TRACE_BRANCH (line);
+    DISPATCH;
+  do_goto:
+    line = this->priv->line;
+    interpret_goto_statement (line->statement->statement.goton);
+    TRACE_BRANCH (line);
+    DISPATCH;
+  do_gosub:
+    interpret_gosub_statement
+      (this->priv->line->statement->statement.gosubn);
+    DISPATCH;
+  do_return:
+    interpret_return_statement ();
+    DISPATCH;
+  do_print:
+    interpret_print_statement
+      (this->priv->line->statement->statement.printn);
+    DISPATCH;
+  do_input:
+    interpret_input_statement
+      (this->priv->line->statement->statement.inputn);
+    DISPATCH;
+  do_step:
+    interpret_step_statement (this->priv->line->statement->statement.stepn);
+    DISPATCH;
+  do_if_goto:
+    line = this->priv->line;
+    interpret_if_goto_statement (line->statement->statement.ifgoton);
+    TRACE_BRANCH (line);
+    DISPATCH;
+  do_end:
+    this->priv->stopped = 1;
+  finish:
+    free (handlers);
+#undef DISPATCH
+}
+
+#else
+
 /*
  * Interpret program starting from a particular line
+ * Without labels-as-values, each line is dispatched through a switch.
  * params:
  *   ProgramLineNode*   program_line   the starting line
  */
 static void interpret_program_from (ProgramLineNode *program_line) {
+  ProgramLineNode *line; /* the line being executed */
   this->priv->line = program_line;
   while (this->priv->line
     && ! this->priv->stopped
-    && ! this->priv->errors->get_code (this->priv->errors))
-    interpret_statement (this->priv->line->statement);
+    && ! this->priv->error) {
+    line = this->priv->line;
+    interpret_statement (line->statement);
+    if (line->statement && ! this->priv->stopped
+      && (line->statement->class == STATEMENT_GOTO
+      || line->statement->class == STATEMENT_IF
+      || line->statement->class == STATEMENT_IF_GOTO))
+      TRACE_BRANCH (line);
+  }
+}
+
+#endif
+
+/*
+ * Interpret program starting from a particular line, profiling each line
+ * params:
+ *   ProgramLineNode*   program_line   the starting line
+ */
+static void profile_program_from (ProgramLineNode *program_line) {
+
+  /* local variables */
+  ProgramLineNode *line; /* the line being executed */
+  int depth; /* the GOSUB stack size before the line */
+  clock_t start, /* the time the line began */
+    finish; /* the time the line ended */
+
+  /* time each line, and each GOSUB up to its RETURN */
+  this->priv->line = program_line;
+  finish = clock ();
+  while (this->priv->line
+    && ! this->priv->stopped
+    && ! this->priv->error) {
+    line = this->priv->line;
+    depth = this->priv->gosub_stack_size;
+    start = finish;
+    interpret_statement (line->statement);
+    finish = clock ();
+    profile_statement (this->priv->profile, line, finish - start);
+    if (this->priv->gosub_stack_size > depth)
+      profile_call (this->priv->profile, this->priv->line, finish);
+    else if (this->priv->gosub_stack_size < depth)
+      profile_return (this->priv->profile, finish);
+  }
+  profile_finish (this->priv->profile, finish);
 }
 
 
@@ -483,10 +835,112 @@ static void interpret_program_from (ProgramLineNode *program_line) {
  *   ProgramNode*   program       the program to interpret
  */
 static void interpret (Interpreter *interpreter, ProgramNode *program) {
+
+  /* local variables */
+  ProgramLineNode *line; /* line counter */
+  JIT *probe; /* a compiler made to see if native code is possible */
+  int size = 0, /* the number of entries in the trace tables */
+    count; /* counter for the trace tables */
+
+  /* initialise */
   this = interpreter;
   this->priv->program = program;
+  this->priv->labels = label_index_create (program, this->priv->options);
+  this->priv->gosub_stack_size = 0;
+  this->priv->gosub_stack_peak = 0;
+  this->priv->error = E_NONE;
   initialise_variables ();
-  interpret_program_from (this->priv->program->first);
+
+  /* prepare to trace hot loops if native code can be generated */
+  if (this->priv->tracing && ! this->priv->profile
+    && (probe = new_JIT (this->priv->errors, this->priv->options))) {
+    probe->destroy (probe);
+    for (line = program->first; line; line = line->next)
+      if (line->source_line >= size)
+        size = line->source_line + 1;
+    this->priv->traces = malloc ((size + 1) * sizeof (JIT *));
+    this->priv->hotness = malloc ((size + 1) * sizeof (int));
+    for (count = 0; count < size; ++count) {
+      this->priv->traces [count] = NULL;
+      this->priv->hotness [count] = 0;
+    }
+  }
+
+  /* run the program */
+  if (this->priv->profile)
+    profile_program_from (this->priv->program->first);
+  else
+    interpret_program_from (this->priv->program->first);
+  flush_output ();
+
+  /* clean up */
+  if (this->priv->traces) {
+    for (count = 0; count < size; ++count)
+      if (this->priv->traces [count])
+        this->priv->traces [count]->destroy (this->priv->traces [count]);
+    free (this->priv->traces);
+    free (this->priv->hotness);
+    this->priv->traces = NULL;
+    this->priv->hotness = NULL;
+  }
+  label_index_destroy (this->priv->labels);
+  this->priv->labels = NULL;
+}
+
+/*
+ * Return the deepest the GOSUB stack has been
+ * params:
+ *   Interpreter*   interpreter   the interpreter to query
+ * returns:
+ *   int                          the peak number of nested GOSUBs
+ */
+static int get_gosub_peak (Interpreter *interpreter) {
+  return interpreter->priv->gosub_stack_peak;
+}
+
+/*
+ * Record a profile of each program line while interpreting
+ * params:
+ *   Interpreter*   interpreter   the interpreter to profile
+ *   Profile*       profile       the profile to record, or NULL for none
+ */
+static void set_profile (Interpreter *interpreter, Profile *profile) {
+  interpreter->priv->profile = profile;
+}
+
+/*
+ * Choose when buffered PRINT output is passed on to the output stream
+ * params:
+ *   Interpreter*   interpreter    the interpreter to configure
+ *   FlushPolicy    flush_policy   the flush policy
+ */
+static void set_flush_policy (Interpreter *interpreter,
+  FlushPolicy flush_policy) {
+  if (flush_policy == FLUSH_AUTO)
+    flush_policy = isatty (fileno (stdout)) ? FLUSH_LINE : FLUSH_BLOCK;
+  interpreter->priv->flush_policy = flush_policy;
+}
+
+/*
+ * Choose where INPUT statements read from
+ * params:
+ *   Interpreter*   interpreter   the interpreter to configure
+ *   InputBuffer*   input         the input buffer, or NULL for stdin
+ */
+static void set_input (Interpreter *interpreter, InputBuffer *input) {
+  interpreter->priv->input = input
+    ? input
+    : interpreter->priv->standard_input;
+}
+
+/*
+ * Choose whether hot loops are traced and compiled to native code
+ * params:
+ *   Interpreter*   interpreter   the interpreter to configure
+ *   int            tracing       !0 to trace hot loops
+ */
+static void set_tracing (Interpreter *interpreter, int tracing) {
+  interpreter->priv->tracing = tracing;
 }
 
 /*
@@ -496,8 +950,16 @@ static void interpret (Interpreter *interpreter, ProgramNode *program) {
  */
 static void destroy (Interpreter *interpreter) {
   if (interpreter) {
-    if (interpreter->priv)
+    if (interpreter->priv) {
+      if (interpreter->priv->gosub_stack)
+        free (interpreter->priv->gosub_stack);
+      if (interpreter->priv->stack)
+        free (interpreter->priv->stack);
+      if (interpreter->priv->output)
+        free (interpreter->priv->output);
+      input_destroy (interpreter->priv->standard_input);
       free (interpreter->priv);
+    }
     free (interpreter);
   }
 }
@@ -521,12 +983,34 @@ Interpreter *new_Interpreter (ErrorHandler *errors, LanguageOptions *options) {
 
   /* initialise methods */
   this->interpret = interpret;
+  this->get_gosub_peak = get_gosub_peak;
+  this->set_profile = set_profile;
+  this->set_flush_policy = set_flush_policy;
+  this->set_input = set_input;
+  this->set_tracing = set_tracing;
   this->destroy = destroy;
 
   /* initialise properties */
-  this->priv->gosub_stack = NULL;
+  this->priv->labels = NULL;
+  this->priv->gosub_stack_limit = options->get_gosub_limit (options);
+  this->priv->gosub_stack = malloc
+    ((this->priv->gosub_stack_limit + 1) * sizeof (ProgramLineNode *));
   this->priv->gosub_stack_size = 0;
+  this->priv->gosub_stack_peak = 0;
+  this->priv->stack = NULL;
+  this->priv->stack_size = 0;
   this->priv->stopped = 0;
+  this->priv->error = E_NONE;
+  this->priv->profile = NULL;
+  this->priv->tracing = 0;
+  this->priv->traces = NULL;
+  this->priv->hotness = NULL;
+  this->priv->condition = 0;
+  this->priv->output = malloc (OUTPUT_BUFFER_SIZE);
+  this->priv->output_length = 0;
+  this->priv->output_size = OUTPUT_BUFFER_SIZE;
+  set_flush_policy (this, FLUSH_AUTO);
+  this->priv->standard_input = this->priv->input = input_create (stdin);
   this->priv->errors = errors;
   this->priv->options = options;
 
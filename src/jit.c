@@ -0,0 +1,1019 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Native Code Compiler Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+
+
+/* native code is generated only for x86-64 with the System V ABI */
+#if defined (__x86_64__) && (defined (__unix__) || defined (__APPLE__))
+
+
+/* further included headers */
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "errors.h"
+#include "options.h"
+#include "statement.h"
+#include "labels.h"
+#include "input.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the initial size of the PRINT output buffer */
+#define JIT_OUTPUT_SIZE 4096
+
+/* compare eax or ecx with its 16-bit sign extension, for range checks */
+#define EAX_CHECK "\x0F\xBF\xC8\x39\xC1" /* movsx ecx, ax; cmp ecx, eax */
+#define ECX_CHECK "\x0F\xBF\xD1\x39\xCA" /* movsx edx, cx; cmp edx, ecx */
+
+/* the state the native code works on, always addressed through rbx */
+typedef struct {
+  int variables [26]; /* the numeric variables */
+  int error_label; /* the label of the line where an error occurred */
+  void **gosub_peak; /* the highest point the GOSUB stack has reached */
+} JITState;
+
+/* the native code entry point */
+typedef ErrorCode (*JITEntry) (JITState *state, void **gosub_stack,
+  void **gosub_limit);
+
+/* a jump to a line, filled in after compilation */
+typedef struct {
+  int address; /* address of the displacement to fill in */
+  ProgramLineNode *target; /* the line jumped to, or NULL for the end */
+} JITFixup;
+
+/* a branch to an error exit, generated after the main code */
+typedef struct {
+  int address; /* address of the displacement to fill in */
+  ErrorCode error; /* the error raised */
+  int label; /* the label of the line raising it */
+  int step; /* the trace step raising it, when compiling a trace */
+} JITStub;
+
+/* private data */
+typedef struct jit_data {
+  unsigned char *code; /* the code being generated */
+  int code_size; /* number of bytes generated */
+  int code_max; /* number of bytes allocated */
+  JITFixup *fixups; /* jumps to be resolved after compilation */
+  int fixup_count; /* number of fixups used */
+  int fixup_max; /* number of fixups allocated */
+  JITStub *stubs; /* error exits to be generated after the main code */
+  int stub_count; /* number of stubs used */
+  int stub_max; /* number of stubs allocated */
+  int *addresses; /* address of each line's code, by source line */
+  LabelIndex *labels; /* index of the program's line labels */
+  ProgramLineNode *line; /* the line being compiled */
+  ProgramLineNode **trace; /* the lines of a compiled trace, or NULL */
+  int step; /* the trace step being compiled */
+  int taken; /* !0 if the IF being compiled held when traced */
+  unsigned char *native; /* the executable copy of the code */
+  size_t native_size; /* the size of the executable copy */
+  void **gosub_stack; /* the return addresses */
+  int gosub_peak; /* highest number of return addresses stacked */
+  JITState state; /* the state the native code works on */
+  char *output; /* PRINT output not yet written */
+  int output_length; /* number of characters in the output buffer */
+  int output_size; /* number of characters the output buffer can hold */
+  FlushPolicy flush_policy; /* when the output buffer is emptied */
+  int column; /* !0 if the current output line is unfinished */
+  int ch; /* the last character read by INPUT */
+  InputBuffer *input; /* where INPUT statements read from */
+  InputBuffer *standard_input; /* the buffer for reading stdin */
+  ErrorHandler *errors; /* the error handler */
+  LanguageOptions *options; /* the language options */
+} JITData;
+
+/* convenience variables */
+static JIT *this; /* the object we are working with */
+
+
+/*
+ * Runtime Helpers, called from the native code
+ */
+
+
+/*
+ * Write out the PRINT output buffer
+ */
+static void flush_output (void) {
+  fwrite (this->priv->output, 1, this->priv->output_length, stdout);
+  fflush (stdout);
+  this->priv->output_length = 0;
+}
+
+/*
+ * Add characters to the PRINT output buffer
+ * The buffer is emptied when full, unless output is held until exit,
+ * and grows when the characters would not fit even when it is empty.
+ * params:
+ *   char*   text     the characters to add
+ *   int     length   the number of characters
+ */
+static void output_text (char *text, int length) {
+  if (this->priv->output_length + length > this->priv->output_size) {
+    if (this->priv->flush_policy != FLUSH_EXIT && this->priv->output_length) {
+      fwrite (this->priv->output, 1, this->priv->output_length, stdout);
+      this->priv->output_length = 0;
+    }
+    while (this->priv->output_length + length > this->priv->output_size)
+      this->priv->output_size *= 2;
+    this->priv->output = realloc (this->priv->output,
+      this->priv->output_size);
+  }
+  memcpy (this->priv->output + this->priv->output_length, text, length);
+  this->priv->output_length += length;
+}
+
+/*
+ * Print a string
+ * params:
+ *   char*   string   the string to print
+ */
+static void jit_print_string (char *string) {
+  output_text (string, strlen (string));
+  this->priv->column = 1;
+}
+
+/*
+ * Print a number
+ * params:
+ *   int   value   the number to print
+ */
+static void jit_print_number (int value) {
+  char digits [8], /* the number written backwards from the end */
+    *digit = digits + sizeof (digits) - 1; /* the next digit to write */
+  unsigned int magnitude; /* the number without its sign */
+  magnitude = value < 0 ? - (unsigned int) value : value;
+  *digit = '\0';
+  do
+    *--digit = '0' + magnitude % 10;
+  while (magnitude /= 10);
+  if (value < 0)
+    *--digit = '-';
+  output_text (digit, digits + sizeof (digits) - 1 - digit);
+  this->priv->column = 1;
+}
+
+/*
+ * End a line of output
+ */
+static void jit_print_newline (void) {
+  output_text ("\n", 1);
+  if (this->priv->flush_policy == FLUSH_LINE)
+    flush_output ();
+  this->priv->column = 0;
+}
+
+/*
+ * Prepare to read the values for an INPUT statement
+ */
+static void jit_input_begin (void) {
+  flush_output ();
+  this->priv->ch = 0;
+}
+
+/*
+ * Read a value into a variable for an INPUT statement
+ * params:
+ *   int*   variable   the variable to read into
+ * returns:
+ *   int               1 if the value was in range, 0 if it was not, or
+ *                     EOF if the input ran out first
+ */
+static int jit_input_value (int *variable) {
+  int value, /* the value read */
+    result; /* the result of reading it */
+  if ((result = input_number (this->priv->input, &value, &this->priv->ch))
+    == 1)
+    *variable = value;
+  return result;
+}
+
+/*
+ * Find the code for a computed GOTO or GOSUB
+ * params:
+ *   int   label   the label jumped to
+ * returns:
+ *   void*         the address of the line's code, or NULL if none
+ */
+static void *jit_find_line (int label) {
+  int line; /* index of the line found */
+  if ((line = label_index_find (this->priv->labels, label)) == -1)
+    return NULL;
+  return this->priv->native + this->priv->addresses
+    [this->priv->labels->lines [line]->source_line];
+}
+
+
+/*
+ * Level 3 Compiler Routines
+ */
+
+
+/*
+ * Append bytes to the generated code
+ * params:
+ *   char*   bytes   the bytes to append
+ *   int     count   the number of bytes
+ */
+static void emit (char *bytes, int count) {
+  while (this->priv->code_size + count > this->priv->code_max) {
+    this->priv->code_max *= 2;
+    this->priv->code = realloc (this->priv->code, this->priv->code_max);
+  }
+  memcpy (this->priv->code + this->priv->code_size, bytes, count);
+  this->priv->code_size += count;
+}
+
+/*
+ * Append a single byte to the generated code
+ * params:
+ *   int   byte   the byte to append
+ */
+static void emit_byte (int byte) {
+  char value = byte; /* the byte as a char */
+  emit (&value, 1);
+}
+
+/*
+ * Append a 32-bit little-endian value to the generated code
+ * params:
+ *   int   value   the value to append
+ */
+static void emit_int (int value) {
+  emit_byte (value);
+  emit_byte (value >> 8);
+  emit_byte (value >> 16);
+  emit_byte (value >> 24);
+}
+
+/*
+ * Append a 64-bit address to the generated code
+ * params:
+ *   void*   address   the address to append
+ */
+static void emit_address (void *address) {
+  emit ((char *) &address, sizeof (void *));
+}
+
+/*
+ * Fill in the displacement of a jump
+ * params:
+ *   int   address   the address of the displacement
+ *   int   target    the address jumped to
+ */
+static void patch_jump (int address, int target) {
+  int displacement = target - (address + 4); /* relative to the next byte */
+  memcpy (this->priv->code + address, &displacement, 4);
+}
+
+
+/*
+ * Level 2 Compiler Routines
+ */
+
+
+/*
+ * Generate a jump with a displacement to be filled in later
+ * params:
+ *   char*   opcode   the jump opcode
+ *   int     length   the length of the opcode
+ * returns:
+ *   int              the address of the displacement
+ */
+static int emit_jump (char *opcode, int length) {
+  emit (opcode, length);
+  emit_int (0);
+  return this->priv->code_size - 4;
+}
+
+/*
+ * Generate a jump to a line
+ * params:
+ *   char*              opcode   the jump opcode
+ *   int                length   the length of the opcode
+ *   ProgramLineNode*   target   the line to jump to, or NULL for the end
+ */
+static void emit_line_jump (char *opcode, int length,
+  ProgramLineNode *target) {
+  if (this->priv->fixup_count == this->priv->fixup_max) {
+    this->priv->fixup_max *= 2;
+    this->priv->fixups = realloc (this->priv->fixups,
+      this->priv->fixup_max * sizeof (JITFixup));
+  }
+  this->priv->fixups [this->priv->fixup_count].address
+    = emit_jump (opcode, length);
+  this->priv->fixups [this->priv->fixup_count++].target = target;
+}
+
+/*
+ * Generate a conditional branch to an error exit for the current line
+ * params:
+ *   char*       opcode   the two-byte conditional jump opcode
+ *   ErrorCode   error    the error to raise
+ */
+static void emit_error_branch (char *opcode, ErrorCode error) {
+  if (this->priv->stub_count == this->priv->stub_max) {
+    this->priv->stub_max *= 2;
+    this->priv->stubs = realloc (this->priv->stubs,
+      this->priv->stub_max * sizeof (JITStub));
+  }
+  this->priv->stubs [this->priv->stub_count].address = emit_jump (opcode, 2);
+  this->priv->stubs [this->priv->stub_count].error = error;
+  this->priv->stubs [this->priv->stub_count].label = this->priv->line->label;
+  this->priv->stubs [this->priv->stub_count++].step = this->priv->step;
+}
+
+/*
+ * Load a value or variable into a register
+ * A variable may hold an unchecked quotient, so it is range-checked.
+ * params:
+ *   char*           value      the opcode loading an immediate value
+ *   char*           variable   the opcode and ModRM byte loading a variable
+ *   char*           check      the code comparing the register with its
+ *                              16-bit sign extension
+ *   ExpressionOp*   operand    the value or variable to load
+ */
+static void emit_load (char *value, char *variable, char *check,
+  ExpressionOp *operand) {
+  if (operand->op == EXPRESSION_OP_VALUE) {
+    emit (value, 1);
+    emit_int (operand->operand);
+  } else {
+    emit (variable, 2);
+    emit_byte (4 * (operand->operand - 1));
+    emit (check, 5);
+    emit_error_branch ("\x0F\x85", E_OVERFLOW); /* jne overflow */
+  }
+}
+
+/*
+ * Generate a call to a runtime helper
+ * params:
+ *   void*   helper   the helper to call
+ */
+static void emit_call (void *helper) {
+  emit ("\x48\xB8", 2); /* mov rax, helper */
+  emit_address (helper);
+  emit ("\xFF\xD0", 2); /* call rax */
+}
+
+/*
+ * Generate a check that eax holds a value in the range of a 16-bit
+ * integer, as the interpreter requires of arithmetic results
+ */
+static void emit_range_check (void) {
+  emit (EAX_CHECK, 5);
+  emit_error_branch ("\x0F\x85", E_OVERFLOW); /* jne overflow */
+}
+
+/*
+ * Generate a jump to the line whose label is in eax
+ */
+static void emit_computed_jump (void) {
+  emit ("\x89\xC7", 2); /* mov edi, eax */
+  emit_call (jit_find_line);
+  emit ("\x48\x85\xC0", 3); /* test rax, rax */
+  emit_error_branch ("\x0F\x84", E_INVALID_LINE_NUMBER); /* jz error */
+  emit ("\xFF\xE0", 2); /* jmp rax */
+}
+
+
+/*
+ * Level 1 Compiler Routines
+ */
+
+
+/*
+ * Compile a flattened expression, leaving its value in eax
+ * Values below the top of the evaluation stack live on the machine stack.
+ * params:
+ *   ExpressionNode*   expression   the expression to compile
+ */
+static void compile_expression (ExpressionNode *expression) {
+
+  /* local variables */
+  ExpressionOp *op, /* the operation being compiled */
+    *end; /* the end of the expression's operations */
+  int depth = 0; /* the number of values on the evaluation stack */
+
+  /* compile each operation in turn */
+  end = expression->ops + expression->op_count;
+  for (op = expression->ops; op < end; ++op)
+    switch (op->op) {
+      case EXPRESSION_OP_VALUE:
+        if (depth++)
+          emit ("\x50", 1); /* push rax */
+        emit ("\xB8", 1); /* mov eax, value */
+        emit_int (op->operand);
+        break;
+      case EXPRESSION_OP_VARIABLE:
+        if (depth++)
+          emit ("\x50", 1); /* push rax */
+        emit ("\x8B\x43", 2); /* mov eax, [rbx + variable] */
+        emit_byte (4 * (op->operand - 1));
+        emit_range_check ();
+        break;
+      case EXPRESSION_OP_NEGATE:
+        emit ("\xF7\xD8", 2); /* neg eax */
+        emit_range_check ();
+        break;
+      case EXPRESSION_OP_GROUP:
+        emit_range_check ();
+        break;
+      case EXPRESSION_OP_ADD:
+        emit ("\x89\xC1\x58", 3); /* mov ecx, eax; pop rax */
+        emit ("\x01\xC8", 2); /* add eax, ecx */
+        emit_range_check ();
+        --depth;
+        break;
+      case EXPRESSION_OP_SUBTRACT:
+        emit ("\x89\xC1\x58", 3); /* mov ecx, eax; pop rax */
+        emit ("\x29\xC8", 2); /* sub eax, ecx */
+        emit_range_check ();
+        --depth;
+        break;
+      case EXPRESSION_OP_MULTIPLY:
+        emit ("\x89\xC1\x58", 3); /* mov ecx, eax; pop rax */
+        emit ("\x0F\xAF\xC1", 3); /* imul eax, ecx */
+        emit_range_check ();
+        --depth;
+        break;
+      case EXPRESSION_OP_DIVIDE:
+        emit ("\x89\xC1\x58", 3); /* mov ecx, eax; pop rax */
+        emit ("\x85\xC9", 2); /* test ecx, ecx */
+        emit_error_branch ("\x0F\x84", E_DIVIDE_BY_ZERO); /* jz error */
+        emit ("\x99\xF7\xF9", 3); /* cdq; idiv ecx */
+        --depth;
+        break;
+      default:
+        this->priv->errors->set_code (this->priv->errors,
+          E_INVALID_EXPRESSION, 0, this->priv->line->label);
+    }
+}
+
+/*
+ * Compile an individual statement
+ * params:
+ *   StatementNode*   statement   the statement to compile
+ */
+static void compile_statement (StatementNode *statement) {
+
+  /* local variables */
+  OutputNode *outn; /* an item in a PRINT list */
+  VariableListNode *variable; /* a variable in an INPUT list */
+  int address, /* the address of a displacement to fill in */
+    items = 0; /* the number of items in a PRINT list */
+  static char *skips [] = { /* branches past an IF's statement */
+    "\x0F\x85", /* = skips if not equal */
+    "\x0F\x84", /* <> skips if equal */
+    "\x0F\x8D", /* < skips if greater or equal */
+    "\x0F\x8F", /* <= skips if greater */
+    "\x0F\x8E", /* > skips if less or equal */
+    "\x0F\x8C" /* >= skips if less */
+  }, *branches [] = { /* branches taken if an IF's condition holds */
+    "\x0F\x84", /* = branches if equal */
+    "\x0F\x85", /* <> branches if not equal */
+    "\x0F\x8C", /* < branches if less */
+    "\x0F\x8E", /* <= branches if less or equal */
+    "\x0F\x8F", /* > branches if greater */
+    "\x0F\x8D" /* >= branches if greater or equal */
+  };
+
+  /* comments generate no code */
+  if (! statement)
+    return;
+
+  /* generate the code for each statement class */
+  switch (statement->class) {
+    case STATEMENT_LET:
+      compile_expression (statement->statement.letn->expression);
+      emit ("\x89\x43", 2); /* mov [rbx + variable], eax */
+      emit_byte (4 * (statement->statement.letn->variable - 1));
+      break;
+    case STATEMENT_IF:
+      compile_expression (statement->statement.ifn->left);
+      emit ("\x50", 1); /* push rax */
+      compile_expression (statement->statement.ifn->right);
+      emit ("\x89\xC1\x58", 3); /* mov ecx, eax; pop rax */
+      emit ("\x39\xC8", 2); /* cmp eax, ecx */
+      if (this->priv->trace && this->priv->taken) {
+        emit_error_branch (skips [statement->statement.ifn->op], E_NONE);
+        compile_statement (statement->statement.ifn->statement);
+      } else if (this->priv->trace)
+        emit_error_branch (branches [statement->statement.ifn->op], E_NONE);
+      else {
+        address = emit_jump (skips [statement->statement.ifn->op], 2);
+        compile_statement (statement->statement.ifn->statement);
+        patch_jump (address, this->priv->code_size);
+      }
+      break;
+    case STATEMENT_IF_GOTO:
+      emit_load ("\xB8", "\x8B\x43", EAX_CHECK, /* mov eax, left */
+        &statement->statement.ifgoton->left);
+      emit_load ("\xB9", "\x8B\x4B", ECX_CHECK, /* mov ecx, right */
+        &statement->statement.ifgoton->right);
+      emit ("\x39\xC8", 2); /* cmp eax, ecx */
+      if (! this->priv->trace)
+        emit_line_jump (branches [statement->statement.ifgoton->op], 2,
+          statement->statement.ifgoton->target);
+      else if (this->priv->taken)
+        emit_error_branch (skips [statement->statement.ifgoton->op], E_NONE);
+      else
+        emit_error_branch (branches [statement->statement.ifgoton->op],
+          E_NONE);
+      break;
+    case STATEMENT_STEP:
+      emit ("\x8B\x43", 2); /* mov eax, [rbx + variable] */
+      emit_byte (4 * (statement->statement.stepn->variable - 1));
+      emit_range_check ();
+      emit_load ("\xB9", "\x8B\x4B", ECX_CHECK, /* mov ecx, operand */
+        &statement->statement.stepn->operand);
+      if (statement->statement.stepn->subtract)
+        emit ("\x29\xC8", 2); /* sub eax, ecx */
+      else
+        emit ("\x01\xC8", 2); /* add eax, ecx */
+      emit_range_check ();
+      emit ("\x89\x43", 2); /* mov [rbx + variable], eax */
+      emit_byte (4 * (statement->statement.stepn->variable - 1));
+      break;
+    case STATEMENT_GOTO:
+      if (this->priv->trace)
+        break; /* the trace continues at the target */
+      if (statement->statement.goton->target)
+        emit_line_jump ("\xE9", 1, statement->statement.goton->target);
+      else {
+        compile_expression (statement->statement.goton->label);
+        emit_computed_jump ();
+      }
+      break;
+    case STATEMENT_GOSUB:
+      emit ("\x4D\x39\xF5", 3); /* cmp r13, r14 */
+      emit_error_branch ("\x0F\x83", E_TOO_MANY_GOSUBS); /* jae error */
+      address = emit_jump ("\x48\x8D\x05", 3); /* lea rax, [return] */
+      emit ("\x49\x89\x45\x00", 4); /* mov [r13], rax */
+      emit ("\x49\x83\xC5\x08", 4); /* add r13, 8 */
+      emit ("\x4D\x39\xFD", 3); /* cmp r13, r15 */
+      emit ("\x76\x03", 2); /* jbe past the next instruction */
+      emit ("\x4D\x89\xEF", 3); /* mov r15, r13 */
+      if (statement->statement.gosubn->target)
+        emit_line_jump ("\xE9", 1, statement->statement.gosubn->target);
+      else {
+        compile_expression (statement->statement.gosubn->label);
+        emit_computed_jump ();
+      }
+      patch_jump (address, this->priv->code_size);
+      break;
+    case STATEMENT_RETURN:
+      emit ("\x4D\x39\xE5", 3); /* cmp r13, r12 */
+      emit_error_branch ("\x0F\x84", E_RETURN_WITHOUT_GOSUB); /* je error */
+      emit ("\x49\x83\xED\x08", 4); /* sub r13, 8 */
+      emit ("\x41\xFF\x65\x00", 4); /* jmp [r13] */
+      break;
+    case STATEMENT_END:
+      emit_line_jump ("\xE9", 1, NULL);
+      break;
+    case STATEMENT_PRINT:
+      for (outn = statement->statement.printn->first; outn;
+        outn = outn->next, ++items)
+        if (outn->class == OUTPUT_STRING) {
+          emit ("\x48\xBF", 2); /* mov rdi, string */
+          emit_address (outn->output.string);
+          emit_call (jit_print_string);
+        } else {
+          compile_expression (outn->output.expression);
+          emit ("\x89\xC7", 2); /* mov edi, eax */
+          emit_call (jit_print_number);
+        }
+      if (items)
+        emit_call (jit_print_newline);
+      break;
+    case STATEMENT_INPUT:
+      emit_call (jit_input_begin);
+      for (variable = statement->statement.inputn->first; variable;
+        variable = variable->next) {
+        emit ("\x48\x8D\x7B", 3); /* lea rdi, [rbx + variable] */
+        emit_byte (4 * (variable->variable - 1));
+        emit_call (jit_input_value);
+        emit ("\x85\xC0", 2); /* test eax, eax */
+        emit_error_branch ("\x0F\x84", E_OVERFLOW); /* jz error */
+        emit_error_branch ("\x0F\x88", E_END_OF_INPUT); /* js error */
+      }
+      break;
+    default:
+      this->priv->errors->set_code (this->priv->errors,
+        E_UNRECOGNISED_COMMAND, 0, this->priv->line->label);
+  }
+}
+
+
+/*
+ * Generate the exits taken by error branches
+ * When compiling a program each exit reports an error; when compiling
+ * a trace each exit returns the step at which the trace is left.
+ * params:
+ *   int   exit_address   the address of the code that returns to C
+ */
+static void emit_stubs (int exit_address) {
+  JITStub *stub; /* the stub to generate */
+  for (stub = this->priv->stubs;
+    stub < this->priv->stubs + this->priv->stub_count; ++stub) {
+    patch_jump (stub->address, this->priv->code_size);
+    if (this->priv->trace) {
+      emit ("\xB8", 1); /* mov eax, step */
+      emit_int (stub->step);
+    } else {
+      emit ("\xC7\x43", 2); /* mov dword [rbx + error_label], label */
+      emit_byte (offsetof (JITState, error_label));
+      emit_int (stub->label);
+      emit ("\xB8", 1); /* mov eax, error */
+      emit_int (stub->error);
+    }
+    patch_jump (emit_jump ("\xE9", 1), exit_address);
+  }
+}
+
+/*
+ * Copy the generated code to executable memory
+ * The memory is released again if the system refuses to make it
+ * executable, as a W^X policy may.
+ * returns:
+ *   int   !0 if the memory was made available
+ */
+static int make_executable (void) {
+  this->priv->native_size = this->priv->code_size;
+  this->priv->native = mmap (NULL, this->priv->native_size,
+    PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (this->priv->native == MAP_FAILED) {
+    this->priv->native = NULL;
+    return 0;
+  }
+  memcpy (this->priv->native, this->priv->code, this->priv->code_size);
+  if (mprotect (this->priv->native, this->priv->native_size,
+    PROT_READ | PROT_EXEC)) {
+    munmap (this->priv->native, this->priv->native_size);
+    this->priv->native = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Find out whether the system lets generated code be made executable
+ * The answer is found once, by trying it on a page of memory.
+ * returns:
+ *   int   !0 if memory can be made executable
+ */
+static int executable_memory (void) {
+  static int executable = -1; /* the answer, or -1 if not yet known */
+  void *page; /* the page of memory tried */
+  if (executable == -1) {
+    page = mmap (NULL, 4096, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    executable = page != MAP_FAILED
+      && ! mprotect (page, 4096, PROT_READ | PROT_EXEC);
+    if (page != MAP_FAILED)
+      munmap (page, 4096);
+  }
+  return executable;
+}
+
+
+/*
+ * Public Methods
+ */
+
+
+/*
+ * Compile a program into native code
+ * params:
+ *   JIT*           jit       the compiler to use
+ *   ProgramNode*   program   the program to compile
+ */
+static void compile (JIT *jit, ProgramNode *program) {
+
+  /* local variables */
+  int end_address, /* the address of the code that ends the program */
+    exit_address, /* the address of the code that returns to C */
+    size = 0, /* the number of line addresses */
+    count; /* counter for lines, fixups and stubs */
+
+  /* index the lines */
+  this = jit;
+  this->priv->labels = label_index_create (program, this->priv->options);
+  for (count = 0; count < this->priv->labels->line_count; ++count)
+    if (this->priv->labels->lines [count]->source_line >= size)
+      size = this->priv->labels->lines [count]->source_line + 1;
+  this->priv->addresses = malloc ((size + 1) * sizeof (int));
+
+  /* save the callee-saved registers and set up the state registers */
+  emit ("\x55\x48\x89\xE5", 4); /* push rbp; mov rbp, rsp */
+  emit ("\x53\x41\x54\x41\x55", 5); /* push rbx; push r12; push r13 */
+  emit ("\x41\x56\x41\x57", 4); /* push r14; push r15 */
+  emit ("\x48\x83\xEC\x08", 4); /* sub rsp, 8 to keep calls aligned */
+  emit ("\x48\x89\xFB", 3); /* mov rbx, rdi: the state */
+  emit ("\x49\x89\xF4", 3); /* mov r12, rsi: the GOSUB stack base */
+  emit ("\x49\x89\xF5", 3); /* mov r13, rsi: the GOSUB stack pointer */
+  emit ("\x49\x89\xD6", 3); /* mov r14, rdx: the GOSUB stack limit */
+  emit ("\x49\x89\xF7", 3); /* mov r15, rsi: the GOSUB stack peak */
+
+  /* compile each line in program order */
+  for (count = 0; count < this->priv->labels->line_count
+    && ! this->priv->errors->get_code (this->priv->errors); ++count) {
+    this->priv->line = this->priv->labels->lines [count];
+    this->priv->addresses [this->priv->line->source_line]
+      = this->priv->code_size;
+    compile_statement (this->priv->line->statement);
+  }
+
+  /* end the program and return the error code to C */
+  end_address = this->priv->code_size;
+  emit ("\x31\xC0", 2); /* xor eax, eax */
+  exit_address = this->priv->code_size;
+  emit ("\x4C\x89\x7B", 3); /* mov [rbx + gosub_peak], r15 */
+  emit_byte (offsetof (JITState, gosub_peak));
+  emit ("\x48\x8D\x65\xD8", 4); /* lea rsp, [rbp - 40] */
+  emit ("\x41\x5F\x41\x5E", 4); /* pop r15; pop r14 */
+  emit ("\x41\x5D\x41\x5C", 4); /* pop r13; pop r12 */
+  emit ("\x5B\x5D\xC3", 3); /* pop rbx; pop rbp; ret */
+
+  /* generate the error exits and resolve the jumps to lines */
+  emit_stubs (exit_address);
+  for (count = 0; count < this->priv->fixup_count; ++count)
+    patch_jump (this->priv->fixups [count].address,
+      this->priv->fixups [count].target
+      ? this->priv->addresses [this->priv->fixups [count].target->source_line]
+      : end_address);
+
+  /* copy the code to executable memory */
+  if (! make_executable ())
+    this->priv->errors->set_code (this->priv->errors, E_MEMORY, 0, 0);
+}
+
+/*
+ * Compile a recorded trace of a loop into native code
+ * The trace runs the loop body in a straight line and repeats it. Each
+ * IF is replaced by a guard that leaves the trace if its condition
+ * changes, and any arithmetic error also leaves it, so that the
+ * interpreter can resume at the line concerned and handle it.
+ * params:
+ *   JIT*               jit      the compiler to use
+ *   ProgramLineNode**  lines    the lines executed, starting at the head
+ *   int*               taken    !0 for each IF whose condition held
+ *   int                count    the number of lines in the trace
+ */
+static void compile_trace (JIT *jit, ProgramLineNode **lines, int *taken,
+  int count) {
+
+  /* local variables */
+  int loop_address, /* the address of the top of the loop */
+    exit_address; /* the address of the code that returns to C */
+
+  /* keep the lines to map the trace's exits back to them */
+  this = jit;
+  this->priv->trace = malloc (count * sizeof (ProgramLineNode *));
+  memcpy (this->priv->trace, lines, count * sizeof (ProgramLineNode *));
+
+  /* save rbx and point it at the variables */
+  emit ("\x55\x48\x89\xE5", 4); /* push rbp; mov rbp, rsp */
+  emit ("\x53\x48\x83\xEC\x08", 5); /* push rbx; sub rsp, 8 */
+  emit ("\x48\x89\xFB", 3); /* mov rbx, rdi: the variables */
+
+  /* compile each step of the trace, and loop back to the head */
+  loop_address = this->priv->code_size;
+  for (this->priv->step = 0; this->priv->step < count; ++this->priv->step) {
+    this->priv->line = lines [this->priv->step];
+    this->priv->taken = taken [this->priv->step];
+    compile_statement (this->priv->line->statement);
+  }
+  patch_jump (emit_jump ("\xE9", 1), loop_address);
+
+  /* return the step at which the trace was left */
+  exit_address = this->priv->code_size;
+  emit ("\x48\x8B\x5D\xF8", 4); /* mov rbx, [rbp - 8] */
+  emit ("\xC9\xC3", 2); /* leave; ret */
+  emit_stubs (exit_address);
+  make_executable ();
+}
+
+/*
+ * Run the compiled native code
+ * params:
+ *   JIT*   jit   the compiler whose code is to be run
+ */
+static void run (JIT *jit) {
+
+  /* local variables */
+  JITEntry entry; /* the entry point of the native code */
+  ErrorCode error; /* runtime error encountered */
+
+  /* initialise */
+  this = jit;
+  if (! this->priv->native)
+    return;
+  memset (&this->priv->state, 0, sizeof (JITState));
+  this->priv->column = 0;
+  this->priv->output_length = 0;
+  memcpy (&entry, &this->priv->native, sizeof (entry));
+
+  /* run the code */
+  error = entry (&this->priv->state, this->priv->gosub_stack,
+    this->priv->gosub_stack
+    + this->priv->options->get_gosub_limit (this->priv->options));
+  this->priv->gosub_peak
+    = this->priv->state.gosub_peak - this->priv->gosub_stack;
+
+  /* report any error against the line that caused it */
+  if (error && this->priv->column)
+    output_text ("\n", 1);
+  flush_output ();
+  if (error) {
+    this->priv->errors->set_code (this->priv->errors, error, 0,
+      this->priv->state.error_label);
+  }
+}
+
+/*
+ * Run a compiled trace until one of its guards fails
+ * params:
+ *   JIT*               jit         the compiler whose trace is to be run
+ *   int*               variables   the program's variables
+ * returns:
+ *   ProgramLineNode*               the line at which interpretation resumes
+ */
+static ProgramLineNode *run_trace (JIT *jit, int *variables) {
+  int (*entry) (int *); /* the entry point of the trace */
+  if (! jit->priv->native)
+    return jit->priv->trace [0];
+  memcpy (&entry, &jit->priv->native, sizeof (entry));
+  return jit->priv->trace [entry (variables)];
+}
+
+/*
+ * Return the deepest the GOSUB stack has been
+ * params:
+ *   JIT*   jit   the compiler to query
+ * returns:
+ *   int          the peak number of nested GOSUBs
+ */
+static int get_gosub_peak (JIT *jit) {
+  return jit->priv->gosub_peak;
+}
+
+/*
+ * Choose when buffered PRINT output is passed on to the output stream
+ * params:
+ *   JIT*          jit            the compiler to configure
+ *   FlushPolicy   flush_policy   the flush policy
+ */
+static void set_flush_policy (JIT *jit, FlushPolicy flush_policy) {
+  if (flush_policy == FLUSH_AUTO)
+    flush_policy = isatty (fileno (stdout)) ? FLUSH_LINE : FLUSH_BLOCK;
+  jit->priv->flush_policy = flush_policy;
+}
+
+/*
+ * Choose where INPUT statements read from
+ * params:
+ *   JIT*           jit     the compiler to configure
+ *   InputBuffer*   input   the input buffer, or NULL for stdin
+ */
+static void set_input (JIT *jit, InputBuffer *input) {
+  jit->priv->input = input
+    ? input
+    : jit->priv->standard_input;
+}
+
+/*
+ * Destroy the compiler
+ * params:
+ *   JIT*   jit   the doomed compiler
+ */
+static void destroy (JIT *jit) {
+  if (jit) {
+    if (jit->priv) {
+      free (jit->priv->code);
+      free (jit->priv->fixups);
+      free (jit->priv->stubs);
+      if (jit->priv->addresses)
+        free (jit->priv->addresses);
+      if (jit->priv->trace)
+        free (jit->priv->trace);
+      label_index_destroy (jit->priv->labels);
+      if (jit->priv->native)
+        munmap (jit->priv->native, jit->priv->native_size);
+      free (jit->priv->gosub_stack);
+      free (jit->priv->output);
+      input_destroy (jit->priv->standard_input);
+      free (jit->priv);
+    }
+    free (jit);
+  }
+}
+
+
+/*
+ * Constructors
+ */
+
+
+/*
+ * Constructor
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   JIT*                         the new compiler, or NULL if the system
+ *                                will not run generated code
+ */
+JIT *new_JIT (ErrorHandler *errors, LanguageOptions *options) {
+
+  /* leave the caller to interpret if code cannot be made executable */
+  if (! executable_memory ())
+    return NULL;
+
+  /* allocate memory */
+  this = malloc (sizeof (JIT));
+  this->priv = malloc (sizeof (JITData));
+
+  /* initialise methods */
+  this->compile = compile;
+  this->run = run;
+  this->compile_trace = compile_trace;
+  this->run_trace = run_trace;
+  this->get_gosub_peak = get_gosub_peak;
+  this->set_flush_policy = set_flush_policy;
+  this->set_input = set_input;
+  this->destroy = destroy;
+
+  /* initialise properties */
+  this->priv->code_max = 4096;
+  this->priv->code = malloc (this->priv->code_max);
+  this->priv->code_size = 0;
+  this->priv->fixup_max = 16;
+  this->priv->fixups = malloc (this->priv->fixup_max * sizeof (JITFixup));
+  this->priv->fixup_count = 0;
+  this->priv->stub_max = 16;
+  this->priv->stubs = malloc (this->priv->stub_max * sizeof (JITStub));
+  this->priv->stub_count = 0;
+  this->priv->addresses = NULL;
+  this->priv->labels = NULL;
+  this->priv->line = NULL;
+  this->priv->trace = NULL;
+  this->priv->step = 0;
+  this->priv->taken = 0;
+  this->priv->native = NULL;
+  this->priv->native_size = 0;
+  this->priv->gosub_stack = malloc
+    ((options->get_gosub_limit (options) + 1) * sizeof (void *));
+  this->priv->gosub_peak = 0;
+  this->priv->output_size = JIT_OUTPUT_SIZE;
+  this->priv->output = malloc (this->priv->output_size);
+  this->priv->output_length = 0;
+  this->priv->column = 0;
+  this->priv->ch = 0;
+  this->priv->standard_input = this->priv->input = input_create (stdin);
+  this->priv->errors = errors;
+  this->priv->options = options;
+  set_flush_policy (this, FLUSH_AUTO);
+
+  /* return the new object */
+  return this;
+}
+
+
+#else
+
+
+/*
+ * Constructor
+ * Native code is not generated for this machine, so no compiler is made.
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   JIT*                         NULL
+ */
+JIT *new_JIT (ErrorHandler *errors, LanguageOptions *options) {
+  return NULL;
+}
+
+
+#endif
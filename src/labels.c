@@ -0,0 +1,226 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Line Label Index Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "labels.h"
+#include "options.h"
+#include "statement.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the largest line limit for which a dense table is built */
+#define DENSE_LABEL_LIMIT 32767
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Compare two label entries for sorting
+ * params:
+ *   const void*   a   the first entry
+ *   const void*   b   the second entry
+ * returns:
+ *   int               <0 if a comes first, >0 if b comes first
+ */
+static int compare_entries (const void *a, const void *b) {
+  const LabelEntry
+    *entry_a = a, /* the first entry */
+    *entry_b = b; /* the second entry */
+  if (entry_a->label != entry_b->label)
+    return (entry_a->label > entry_b->label)
+      - (entry_a->label < entry_b->label);
+  return (entry_a->line > entry_b->line) - (entry_a->line < entry_b->line);
+}
+
+/*
+ * Build a dense table with an entry for every possible label
+ * params:
+ *   LabelIndex*   index       the label index
+ *   int           max_label   the highest label in the program
+ * returns:
+ *   int                       !0 if the table was built
+ */
+static int build_dense (LabelIndex *index, int max_label) {
+
+  /* local variables */
+  int count; /* line and label counter */
+
+  /* allocate the table */
+  index->dense_size = max_label + 1;
+  if (! (index->dense = malloc (index->dense_size * sizeof (int))))
+    return 0;
+  for (count = 0; count < index->dense_size; ++count)
+    index->dense [count] = -1;
+
+  /* mark each label with the first line that carries it */
+  for (count = index->line_count - 1; count >= 0; --count)
+    if (index->lines [count]->label >= 0)
+      index->dense [index->lines [count]->label] = count;
+
+  /* when inexact, unused labels lead to the first line above them */
+  if (! index->exact)
+    for (count = index->dense_size - 2; count >= 0; --count)
+      if (index->dense [count + 1] != -1
+        && (index->dense [count] == -1
+        || index->dense [count + 1] < index->dense [count]))
+        index->dense [count] = index->dense [count + 1];
+
+  /* success */
+  return 1;
+}
+
+/*
+ * Build a sorted table of the labels in the program
+ * params:
+ *   LabelIndex*   index   the label index
+ */
+static void build_sorted (LabelIndex *index) {
+
+  /* local variables */
+  int count; /* line counter */
+
+  /* list the labels and sort them */
+  index->sorted_count = index->line_count;
+  index->sorted = malloc ((index->sorted_count + 1) * sizeof (LabelEntry));
+  for (count = 0; count < index->line_count; ++count) {
+    index->sorted [count].label = index->lines [count]->label;
+    index->sorted [count].line = count;
+  }
+  qsort (index->sorted, index->sorted_count, sizeof (LabelEntry),
+    compare_entries);
+
+  /* when inexact, each entry leads to the first line at or above it */
+  if (! index->exact)
+    for (count = index->sorted_count - 2; count >= 0; --count)
+      if (index->sorted [count + 1].line < index->sorted [count].line)
+        index->sorted [count].line = index->sorted [count + 1].line;
+}
+
+
+/*
+ * Top Level Routines
+ */
+
+
+/*
+ * Build a label index for a program
+ * params:
+ *   ProgramNode*       program   the program to index
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   LabelIndex*                  the new label index
+ */
+LabelIndex *label_index_create (ProgramNode *program,
+  LanguageOptions *options) {
+
+  /* local variables */
+  LabelIndex *index; /* the index to build */
+  ProgramLineNode *program_line; /* a line to index */
+  int
+    count = 0, /* line counter */
+    max_label = 0; /* the highest label in the program */
+
+  /* allocate memory and initialise members */
+  index = malloc (sizeof (LabelIndex));
+  index->dense = NULL;
+  index->dense_size = 0;
+  index->sorted = NULL;
+  index->sorted_count = 0;
+  index->exact = (options->get_line_numbers (options)
+    == LINE_NUMBERS_OPTIONAL);
+
+  /* list the program lines in order */
+  for (program_line = program->first; program_line;
+    program_line = program_line->next)
+    ++count;
+  index->line_count = count;
+  index->lines = malloc ((count + 1) * sizeof (ProgramLineNode *));
+  count = 0;
+  for (program_line = program->first; program_line;
+    program_line = program_line->next) {
+    index->lines [count++] = program_line;
+    if (program_line->label > max_label)
+      max_label = program_line->label;
+  }
+
+  /* build a dense table if labels are bounded, or a sorted one if not */
+  if (options->get_line_limit (options) > DENSE_LABEL_LIMIT
+    || ! build_dense (index, max_label))
+    build_sorted (index);
+
+  /* return the index */
+  return index;
+}
+
+/*
+ * Find the line a GOTO or GOSUB would reach for a given label
+ * params:
+ *   LabelIndex*   index   the label index
+ *   int           label   the label to look for
+ * returns:
+ *   int                   the index of the line, or -1 if there is none
+ */
+int label_index_find (LabelIndex *index, int label) {
+
+  /* local variables */
+  int
+    low, /* lowest entry still being considered */
+    high, /* one past the highest entry still being considered */
+    middle; /* the entry we're testing */
+
+  /* labels below zero reach the first line, unless they must match */
+  if (label < 0)
+    return (index->exact || ! index->line_count) ? -1 : 0;
+
+  /* look the label up directly in a dense table */
+  if (index->dense)
+    return (label < index->dense_size) ? index->dense [label] : -1;
+
+  /* otherwise find the first sorted entry at or above the label */
+  low = 0;
+  high = index->sorted_count;
+  while (low < high) {
+    middle = low + (high - low) / 2;
+    if (index->sorted [middle].label < label)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  if (low == index->sorted_count
+    || (index->exact && index->sorted [low].label != label))
+    return -1;
+  return index->sorted [low].line;
+}
+
+/*
+ * Destroy a label index
+ * params:
+ *   LabelIndex*   index   the doomed label index
+ */
+void label_index_destroy (LabelIndex *index) {
+  if (index) {
+    if (index->lines)
+      free (index->lines);
+    if (index->dense)
+      free (index->dense);
+    if (index->sorted)
+      free (index->sorted);
+    free (index);
+  }
+}
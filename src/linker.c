@@ -0,0 +1,183 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Linker Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "linker.h"
+#include "errors.h"
+#include "options.h"
+#include "statement.h"
+#include "labels.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* private data */
+typedef struct linker_data {
+  LabelIndex *labels; /* index of the program's line labels */
+  ProgramLineNode *line; /* the line being linked */
+  ErrorHandler *errors; /* the error handler */
+  LanguageOptions *options; /* the language options */
+} LinkerData;
+
+/* convenience variables */
+static Linker *this; /* the object we are working with */
+
+
+/*
+ * Level 2 Routines
+ */
+
+
+/*
+ * Find the line reached by a constant label expression
+ * params:
+ *   ExpressionNode*   label   the label expression
+ * returns:
+ *   ProgramLineNode*          the line reached, or NULL if not constant
+ */
+static ProgramLineNode *resolve_label (ExpressionNode *label) {
+
+  /* local variables */
+  int line; /* index of the line reached */
+
+  /* only a constant, possibly negated, can be resolved */
+  if (label->ops [0].op != EXPRESSION_OP_VALUE
+    || (label->op_count == 2 && label->ops [1].op != EXPRESSION_OP_NEGATE)
+    || label->op_count > 2)
+    return NULL;
+
+  /* look up the label, and report it if it does not exist */
+  line = label_index_find (this->priv->labels, label->op_count == 2
+    ? -label->ops [0].operand
+    : label->ops [0].operand);
+  if (line == -1) {
+    this->priv->errors->set_code (this->priv->errors,
+      E_INVALID_LINE_NUMBER, this->priv->line->source_line,
+      this->priv->line->label);
+    return NULL;
+  }
+  return this->priv->labels->lines [line];
+}
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Link an individual statement
+ * params:
+ *   StatementNode*   statement   the statement to link
+ */
+static void link_statement (StatementNode *statement) {
+
+  /* comments need no linking */
+  if (! statement)
+    return;
+
+  /* resolve the targets of jumps, including those nested in IFs */
+  switch (statement->class) {
+    case STATEMENT_IF:
+      link_statement (statement->statement.ifn->statement);
+      break;
+    case STATEMENT_GOTO:
+      statement->statement.goton->target
+        = resolve_label (statement->statement.goton->label);
+      break;
+    case STATEMENT_GOSUB:
+      statement->statement.gosubn->target
+        = resolve_label (statement->statement.gosubn->label);
+      break;
+    default:
+      break;
+  }
+}
+
+
+/*
+ * Public Methods
+ */
+
+
+/*
+ * Resolve the constant GOTO and GOSUB targets in a program
+ * params:
+ *   Linker*        linker    the linker to use
+ *   ProgramNode*   program   the program to link
+ */
+static void link_program (Linker *linker, ProgramNode *program) {
+
+  /* initialise */
+  this = linker;
+  this->priv->labels = label_index_create (program, this->priv->options);
+
+  /* link each line until an error is found */
+  for (this->priv->line = program->first;
+    this->priv->line && ! this->priv->errors->get_code (this->priv->errors);
+    this->priv->line = this->priv->line->next)
+    link_statement (this->priv->line->statement);
+
+  /* clean up */
+  label_index_destroy (this->priv->labels);
+  this->priv->labels = NULL;
+}
+
+/*
+ * Destroy the linker
+ * params:
+ *   Linker*   linker   the doomed linker
+ */
+static void destroy (Linker *linker) {
+  if (linker) {
+    if (linker->priv)
+      free (linker->priv);
+    free (linker);
+  }
+}
+
+
+/*
+ * Constructors
+ */
+
+
+/*
+ * Constructor
+ * params:
+ *   ErrorHandler*      errors    the error handler
+ *   LanguageOptions*   options   the language options
+ * returns:
+ *   Linker*                      the new linker
+ */
+Linker *new_Linker (ErrorHandler *errors, LanguageOptions *options) {
+
+  /* allocate memory */
+  this = malloc (sizeof (Linker));
+  this->priv = malloc (sizeof (LinkerData));
+
+  /* initialise methods */
+  this->link = link_program;
+  this->destroy = destroy;
+
+  /* initialise properties */
+  this->priv->labels = NULL;
+  this->priv->line = NULL;
+  this->priv->errors = errors;
+  this->priv->options = options;
+
+  /* return the new object */
+  return this;
+}
@@ -0,0 +1,311 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Shared Object Loader Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loader.h"
+
+
+/* shared objects are loaded only where dlopen is available */
+#if defined (__unix__) || defined (__APPLE__)
+
+
+/* further included headers */
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include "strbuf.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the FNV-1a hash parameters */
+#define HASH_BASIS 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Add a block of bytes to a hash
+ * params:
+ *   unsigned long long   hash     the hash so far
+ *   char*                bytes    the bytes to add
+ *   size_t               length   the number of bytes
+ * returns:
+ *   unsigned long long            the new hash
+ */
+static unsigned long long hash_bytes (unsigned long long hash, char *bytes,
+  size_t length) {
+  while (length--) {
+    hash ^= (unsigned char) *bytes++;
+    hash *= HASH_PRIME;
+  }
+  return hash;
+}
+
+/*
+ * Check that a directory is private to the user, creating it if need be
+ * A directory that others can write to might hold objects planted there,
+ * so it is not used as a cache.
+ * params:
+ *   char*   directory   the directory name
+ * returns:
+ *   int                 !0 if the directory is owned by the user and is
+ *                       writable by nobody else
+ */
+static int private_directory (char *directory) {
+  struct stat status; /* the directory's owner and mode */
+  mkdir (directory, 0700);
+  return ! lstat (directory, &status)
+    && S_ISDIR (status.st_mode)
+    && status.st_uid == geteuid ()
+    && ! (status.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+/*
+ * Find or create the cache directory
+ * The directory is $TBCACHE if that is set, otherwise tinybasic in the
+ * user's cache directory, otherwise a per-user directory in /tmp.
+ * returns:
+ *   char*   the directory name, which the caller frees, or NULL if there
+ *           is no private directory to use
+ */
+static char *cache_directory (void) {
+
+  /* local variables */
+  char *directory, /* the directory name */
+    *name; /* the configured or home directory */
+
+  /* use the configured directory */
+  if ((name = getenv ("TBCACHE")) && *name) {
+    if ((directory = malloc (strlen (name) + 1)))
+      strcpy (directory, name);
+    if (directory && private_directory (directory))
+      return directory;
+    free (directory);
+    return NULL;
+  }
+
+  /* use a directory in the user's cache, creating the cache if need be */
+  if ((name = getenv ("HOME")) && *name
+    && (directory = malloc (strlen (name) + 24))) {
+    sprintf (directory, "%s/.cache", name);
+    mkdir (directory, 0700);
+    strcat (directory, "/tinybasic");
+    if (private_directory (directory))
+      return directory;
+    free (directory);
+  }
+
+  /* otherwise fall back on a directory of the user's own in /tmp */
+  if ((directory = malloc (40))) {
+    sprintf (directory, "/tmp/tinybasic-%ld", (long) geteuid ());
+    if (private_directory (directory))
+      return directory;
+    free (directory);
+  }
+  return NULL;
+}
+
+/*
+ * Substitute the source and target names into a compiler command
+ * params:
+ *   char*   command   the command with $(SOURCE) and $(TARGET) tokens
+ *   char*   source    the C source filename
+ *   char*   target    the shared object filename
+ * returns:
+ *   char*             the completed command, which the caller frees
+ */
+static char *expand_command (char *command, char *source, char *target) {
+  StringBuffer *expanded; /* the command being built */
+  expanded = strbuf_create ();
+  while (*command)
+    if (! strncmp (command, "$(SOURCE)", 9)) {
+      strbuf_append (expanded, source);
+      command += 9;
+    } else if (! strncmp (command, "$(TARGET)", 9)) {
+      strbuf_append (expanded, target);
+      command += 9;
+    } else
+      strbuf_append_char (expanded, *command++);
+  return strbuf_release (expanded);
+}
+
+
+/*
+ * Public Functions
+ */
+
+
+/*
+ * Work out where the shared object for a program is cached
+ * The name is a hash of the generated C program and the compiler command,
+ * so any change to the program, its options or the build of tinybasic
+ * itself leads to a fresh compilation.
+ * params:
+ *   char*   c_source   the C program
+ *   char*   command    the compiler command
+ * returns:
+ *   char*              the path of the shared object, which the caller
+ *                      frees, or NULL if there is no cache directory
+ */
+char *loader_cache_path (char *c_source, char *command) {
+
+  /* local variables */
+  char *directory, /* the cache directory */
+    *path; /* the path of the shared object */
+  unsigned long long hash = HASH_BASIS; /* the hash of the program */
+
+  /* hash the program and the command */
+  hash = hash_bytes (hash, c_source, strlen (c_source) + 1);
+  hash = hash_bytes (hash, command, strlen (command));
+
+  /* name the shared object after the hash */
+  if (! (directory = cache_directory ()))
+    return NULL;
+  if ((path = malloc (strlen (directory) + 21)))
+    sprintf (path, "%s/%016llx.so", directory, hash);
+  free (directory);
+  return path;
+}
+
+/*
+ * Compile a C program into a shared object in the cache
+ * The object is built under a temporary name and renamed into place, so
+ * that concurrent runs of the same program never load a partial object.
+ * params:
+ *   char*   path       the cache path of the shared object
+ *   char*   c_source   the C program
+ *   char*   command    the compiler command, with $(SOURCE) and $(TARGET)
+ * returns:
+ *   int                !0 if the shared object was built
+ */
+int loader_build (char *path, char *c_source, char *command) {
+
+  /* local variables */
+  FILE *output; /* the C source file */
+  char *source, /* the temporary C source filename */
+    *target, /* the temporary shared object filename */
+    *expanded; /* the compiler command with the filenames */
+  int built = 0; /* !0 if the shared object was built */
+
+  /* name the temporary files after the object and this process */
+  source = malloc (strlen (path) + 32);
+  target = malloc (strlen (path) + 32);
+  if (! source || ! target) {
+    free (source);
+    free (target);
+    return 0;
+  }
+  sprintf (source, "%s.%ld.c", path, (long) getpid ());
+  sprintf (target, "%s.%ld.tmp", path, (long) getpid ());
+
+  /* write the C source and compile it */
+  if ((output = fopen (source, "w"))) {
+    fputs (c_source, output);
+    fclose (output);
+    expanded = expand_command (command, source, target);
+    built = ! system (expanded) && ! rename (target, path);
+    free (expanded);
+    remove (source);
+    if (! built)
+      remove (target);
+  }
+
+  /* clean up */
+  free (source);
+  free (target);
+  return built;
+}
+
+/*
+ * Load a shared object and run its program
+ * The program normally ends the process itself, with its exit code.
+ * params:
+ *   char*   path   the path of the shared object
+ * returns:
+ *   int            0 if the shared object could not be loaded
+ */
+int loader_run (char *path) {
+
+  /* local variables */
+  void *object; /* the loaded shared object */
+  void (*bas_exec) (void); /* the program's entry point */
+
+  /* load the object and find the program */
+  if (! (object = dlopen (path, RTLD_NOW | RTLD_LOCAL)))
+    return 0;
+  if (! (*(void **) &bas_exec = dlsym (object, "bas_exec"))) {
+    dlclose (object);
+    return 0;
+  }
+
+  /* run it */
+  fflush (stdout);
+  bas_exec ();
+  dlclose (object);
+  return 1;
+}
+
+
+#else
+
+
+/*
+ * Public Functions
+ * Without dlopen no shared object is built, and the caller reports it.
+ */
+
+
+/*
+ * Work out where the shared object for a program is cached
+ * params:
+ *   char*   c_source   the C program
+ *   char*   command    the compiler command
+ * returns:
+ *   char*              NULL, as there is no cache
+ */
+char *loader_cache_path (char *c_source, char *command) {
+  return NULL;
+}
+
+/*
+ * Compile a C program into a shared object in the cache
+ * params:
+ *   char*   path       the cache path of the shared object
+ *   char*   c_source   the C program
+ *   char*   command    the compiler command, with $(SOURCE) and $(TARGET)
+ * returns:
+ *   int                0, as no shared object can be built
+ */
+int loader_build (char *path, char *c_source, char *command) {
+  return 0;
+}
+
+/*
+ * Load a shared object and run its program
+ * params:
+ *   char*   path   the path of the shared object
+ * returns:
+ *   int            0, as no shared object can be loaded
+ */
+int loader_run (char *path) {
+  return 0;
+}
+
+
+#endif
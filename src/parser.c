@@ -19,6 +19,7 @@
 #include "tokeniser.h"
 #include "parser.h"
 #include "expression.h"
+#include "arena.h"
 
 
 /*
@@ -43,7 +44,9 @@ typedef struct parser_data {
   int last_label; /* last line label encountered */
   int current_line; /* the last source line parsed */
   int end_of_file; /* end of file signal */
-  Token *stored_token; /* token read ahead */
+  TokenRecord *tokens; /* the tokens being parsed */
+  int token_count; /* number of tokens, the last being TOKEN_EOF */
+  int next_token; /* index of the next token to parse */
   TokenStream *stream; /* the input stream */
   ErrorHandler *errors; /* the parse error handler */
   LanguageOptions *options; /* the language options */
@@ -59,27 +62,66 @@ static Parser *this; /* the current parser being worked on */
 
 
 /*
- * Get next token to parse, from read-ahead buffer or tokeniser.
+ * Get next token to parse. Reading past the end yields TOKEN_EOF again.
+ * returns:
+ *   TokenRecord*   the token to parse
  */
-static Token *get_token_to_parse () {
+static TokenRecord *get_token_to_parse () {
 
   /* local variables */
-  Token *token; /* token to return */
+  TokenRecord *token; /* token to return */
 
-  /* get the token one way or another */
-  if (this->priv->stored_token) {
-    token = this->priv->stored_token;
-    this->priv->stored_token = NULL;
-  } else
-    token = this->priv->stream->next (this->priv->stream);
+  /* get the token, staying on the EOF token at the end */
+  token = (this->priv->next_token < this->priv->token_count)
+    ? &this->priv->tokens [this->priv->next_token]
+    : &this->priv->tokens [this->priv->token_count - 1];
+  ++this->priv->next_token;
 
   /* store the line, check EOF and return the token */
-  this->priv->current_line = token->get_line (token);
-  if (token->get_class (token) == TOKEN_EOF)
+  this->priv->current_line = token->line;
+  if (token->class == TOKEN_EOF)
     this->priv->end_of_file = !0;
   return token;
 }
 
+/*
+ * Put back the last token read, to be read again next time
+ */
+static void unget_token (void) {
+  --this->priv->next_token;
+}
+
+/*
+ * Copy a string literal out of the source, processing escape sequences
+ * params:
+ *   Token*   token   the string token
+ * returns:
+ *   char*            the string, allocated with the program's nodes
+ */
+static char *copy_string (TokenRecord *token) {
+
+  /* local variables */
+  char
+    *source, /* the next character of the literal */
+    *end, /* the end of the literal */
+    *string, /* the copied string */
+    *dest; /* the next character of the copy */
+
+  /* a backslash escapes the character that follows it */
+  source = token->content;
+  end = source + token->length;
+  string = dest = arena_allocate (token->length + 1);
+  while (source < end) {
+    if (*source == '\\')
+      ++source;
+    *dest++ = *source++;
+  }
+  *dest = '\0';
+
+  /* return the copy */
+  return string;
+}
+
 /*
  * Parse a factor
  * returns:
@@ -88,7 +130,7 @@ static Token *get_token_to_parse () {
 static FactorNode *parse_factor (void) {
 
   /* local variables */
-  Token *token; /* token to read */
+  TokenRecord *token; /* token to read */
   FactorNode *factor = NULL; /* the factor we're building */
   ExpressionNode *expression = NULL; /* any parenthesised expression */
   int start_line; /* the line on which this factor occurs */
@@ -96,63 +138,54 @@ static FactorNode *parse_factor (void) {
   /* initialise the factor and grab the next token */
   factor = factor_create ();
   token = get_token_to_parse ();
-  start_line = token->get_line (token);
+  start_line = token->line;
 
   /* interpret a sign */
-  if (token->get_class (token) == TOKEN_PLUS
-    || token->get_class (token) == TOKEN_MINUS) {
-    factor->sign = (token->get_class (token) == TOKEN_PLUS)
+  if (token->class == TOKEN_PLUS
+    || token->class == TOKEN_MINUS) {
+    factor->sign = (token->class == TOKEN_PLUS)
       ? SIGN_POSITIVE
       : SIGN_NEGATIVE;
-    token->destroy (token);
     token = get_token_to_parse ();
   }
 
   /* interpret a number */
-  if (token->get_class (token) == TOKEN_NUMBER) {
+  if (token->class == TOKEN_NUMBER) {
     factor->class = FACTOR_VALUE;
-    factor->data.value = atoi (token->get_content (token));
+    factor->data.value = atoi (token->content);
     if (factor->data.value < -32768 || factor->data.value > 32767)
       this->priv->errors->set_code
         (this->priv->errors, E_OVERFLOW, start_line, this->priv->last_label);
-    token->destroy (token);
   }
 
   /* interpret a variable */
-  else if (token->get_class (token) == TOKEN_VARIABLE) {
+  else if (token->class == TOKEN_VARIABLE) {
     factor->class = FACTOR_VARIABLE;
-    factor->data.variable = (int) *token->get_content (token) & 0x1F;
-    token->destroy (token);
+    factor->data.variable = (int) *token->content & 0x1F;
   }
 
   /* interpret an parenthesised expression */
-  else if (token->get_class (token) == TOKEN_LEFT_PARENTHESIS) {
+  else if (token->class == TOKEN_LEFT_PARENTHESIS) {
 
     /* parse the parenthesised expression and complete the factor */
-    token->destroy (token);
     expression = parse_expression ();
     if (expression) {
       token = get_token_to_parse ();
-      if (token->get_class (token) == TOKEN_RIGHT_PARENTHESIS) {
+      if (token->class == TOKEN_RIGHT_PARENTHESIS) {
         factor->class = FACTOR_EXPRESSION;
         factor->data.expression = expression;
       } else {
         this->priv->errors->set_code
           (this->priv->errors, E_MISSING_RIGHT_PARENTHESIS, start_line,
             this->priv->last_label);
-        factor_destroy (factor);
         factor = NULL;
-        expression_destroy (expression);
       }
-      token->destroy (token);
     }
 
     /* clean up after invalid parenthesised expression */
     else {
       this->priv->errors->set_code (this->priv->errors, E_INVALID_EXPRESSION,
-        token->get_line (token), this->priv->last_label);
-      token->destroy (token);
-      factor_destroy (factor);
+        token->line, this->priv->last_label);
       factor = NULL;
     }
   }
@@ -160,10 +193,8 @@ static FactorNode *parse_factor (void) {
   /* deal with other errors */
   else {
     this->priv->errors->set_code
-      (this->priv->errors, E_INVALID_EXPRESSION, token->get_line (token),
+      (this->priv->errors, E_INVALID_EXPRESSION, token->line,
         this->priv->last_label);
-    factor_destroy (factor);
-    token->destroy (token);
     factor = NULL;
   }
 
@@ -173,8 +204,6 @@ static FactorNode *parse_factor (void) {
 
 /*
  * Parse a term
- * globals:
- *   Token*      stored_token   the token read past the end of the term
  * returns:
  *   TermNode*   a new term node holding the parsed term
  */
@@ -186,7 +215,7 @@ static TermNode *parse_term (void) {
   RightHandFactor
     *rhptr = NULL, /* previous right-hand factor */
     *rhfactor = NULL; /* right-hand factor detected */
-  Token *token = NULL; /* token read while looking for operator */
+  TokenRecord *token = NULL; /* token read while looking for operator */
 
   /* scan the first factor */
   if ((factor = parse_factor ())) {
@@ -197,12 +226,12 @@ static TermNode *parse_term (void) {
     /* look for subsequent factors */
     while ((token = get_token_to_parse ())
       && ! this->priv->errors->get_code (this->priv->errors)
-      && (token->get_class (token) == TOKEN_MULTIPLY
-      || token->get_class (token) == TOKEN_DIVIDE)) {
+      && (token->class == TOKEN_MULTIPLY
+      || token->class == TOKEN_DIVIDE)) {
 
       /* parse the sign and the factor */
       rhfactor = rhfactor_create ();
-      rhfactor->op = token->get_class (token) == TOKEN_MULTIPLY
+      rhfactor->op = token->class == TOKEN_MULTIPLY
           ? TERM_OPERATOR_MULTIPLY
           : TERM_OPERATOR_DIVIDE;
       if ((rhfactor->factor = parse_factor ())) {
@@ -216,19 +245,16 @@ static TermNode *parse_term (void) {
 
       /* set an error if we read an operator but not a factor */
       else {
-        rhfactor_destroy (rhfactor);
         if (! this->priv->errors->get_code (this->priv->errors))
           this->priv->errors->set_code
-            (this->priv->errors, E_INVALID_EXPRESSION, token->get_line (token),
+            (this->priv->errors, E_INVALID_EXPRESSION, token->line,
               this->priv->last_label);
       }
 
-      /* clean up token */
-      token->destroy (token);
     }
 
     /* we've read past the end of the term; put the token back */
-    this->priv->stored_token = token;
+    unget_token ();
   }
 
   /* return the evaluated term, if any */
@@ -248,7 +274,7 @@ static ExpressionNode *parse_expression (void) {
   RightHandTerm
     *rhterm = NULL, /* the right-hand term detected */
     *rhptr = NULL; /* pointer to the previous right-hand term */
-  Token *token; /* token read when scanning for right-hand terms */
+  TokenRecord *token; /* token read when scanning for right-hand terms */
 
   /* scan the first term */
   if ((term = parse_term ())) {
@@ -259,12 +285,12 @@ static ExpressionNode *parse_expression (void) {
     /* look for subsequent terms */
     while ((token = get_token_to_parse ())
       && ! this->priv->errors->get_code (this->priv->errors)
-      && (token->get_class (token) == TOKEN_PLUS
-      || token->get_class (token) == TOKEN_MINUS)) {
+      && (token->class == TOKEN_PLUS
+      || token->class == TOKEN_MINUS)) {
 
       /* parse the sign and the factor */
       rhterm = rhterm_create ();
-      rhterm->op = token->get_class (token) == TOKEN_PLUS
+      rhterm->op = token->class == TOKEN_PLUS
           ? EXPRESSION_OPERATOR_PLUS
           : EXPRESSION_OPERATOR_MINUS;
       if ((rhterm->term = parse_term ())) {
@@ -278,19 +304,16 @@ static ExpressionNode *parse_expression (void) {
 
       /* set an error condition if we read a sign but not a factor */
       else {
-        rhterm_destroy (rhterm);
         if (! this->priv->errors->get_code (this->priv->errors))
           this->priv->errors->set_code
-            (this->priv->errors, E_INVALID_EXPRESSION, token->get_line (token),
+            (this->priv->errors, E_INVALID_EXPRESSION, token->line,
               this->priv->last_label);
       }
 
-      /* clean up token */
-      token->destroy (token);
     }
 
     /* we've read past the end of the term; put the token back */
-    this->priv->stored_token = token;
+    unget_token ();
   }
 
   /* return the evaluated expression, if any */
@@ -349,7 +372,7 @@ static int validate_line_label (int label) {
 static StatementNode *parse_let_statement (void) {
 
   /* local variables */
-  Token *token; /* tokens read as part of LET statement */
+  TokenRecord *token; /* tokens read as part of LET statement */
   int line; /* line containing the LET token */
   StatementNode *statement; /* the new statement */
 
@@ -357,37 +380,30 @@ static StatementNode *parse_let_statement (void) {
   statement = statement_create ();
   statement->class = STATEMENT_LET;
   statement->statement.letn = statement_create_let ();
-  line = this->priv->stream->get_line (this->priv->stream);
+  line = this->priv->current_line;
 
   /* see what variable we're assigning */
   token = get_token_to_parse ();
-  if (token->get_class (token) != TOKEN_VARIABLE) {
+  if (token->class != TOKEN_VARIABLE) {
     this->priv->errors->set_code
       (this->priv->errors, E_INVALID_VARIABLE, line, this->priv->last_label);
-    statement_destroy (statement);
-    token->destroy (token);
     return NULL;
   }
-  statement->statement.letn->variable = *token->get_content (token) & 0x1f;
+  statement->statement.letn->variable = *token->content & 0x1f;
 
   /* get the "=" */
-  token->destroy (token);
   token = get_token_to_parse ();
-  if (token->get_class (token) != TOKEN_EQUAL) {
+  if (token->class != TOKEN_EQUAL) {
     this->priv->errors->set_code
       (this->priv->errors, E_INVALID_ASSIGNMENT, line, this->priv->last_label);
-    statement_destroy (statement);
-    token->destroy (token);
     return NULL;
   }
-  token->destroy (token);
 
   /* get the expression */
   statement->statement.letn->expression = parse_expression ();
   if (! statement->statement.letn->expression) {
     this->priv->errors->set_code
       (this->priv->errors, E_INVALID_EXPRESSION, line, this->priv->last_label);
-    statement_destroy (statement);
     return NULL;
   }
 
@@ -403,7 +419,7 @@ static StatementNode *parse_let_statement (void) {
 static StatementNode *parse_if_statement (void) {
 
   /* local variables */
-  Token *token; /* tokens read as part of the statement */
+  TokenRecord *token; /* tokens read as part of the statement */
   StatementNode *statement; /* the IF statement */
 
   /* initialise the statement */
@@ -417,7 +433,7 @@ static StatementNode *parse_if_statement (void) {
   /* parse the operator */
   if (! this->priv->errors->get_code (this->priv->errors)) {
     token = get_token_to_parse ();
-    switch (token->get_class (token)) {
+    switch (token->class) {
     case TOKEN_EQUAL:
       statement->statement.ifn->op = RELOP_EQUAL;
       break;
@@ -438,10 +454,9 @@ static StatementNode *parse_if_statement (void) {
       break;
     default:
       this->priv->errors->set_code
-        (this->priv->errors, E_INVALID_OPERATOR, token->get_line (token),
+        (this->priv->errors, E_INVALID_OPERATOR, token->line,
         this->priv->last_label);
     }
-    token->destroy (token);
   }
 
   /* parse the second expression */
@@ -451,22 +466,19 @@ static StatementNode *parse_if_statement (void) {
   /* parse the THEN */
   if (! this->priv->errors->get_code (this->priv->errors)) {
     token = get_token_to_parse ();
-    if (token->get_class (token) != TOKEN_THEN)
+    if (token->class != TOKEN_THEN)
       this->priv->errors->set_code
-        (this->priv->errors, E_THEN_EXPECTED, token->get_line (token), 
+        (this->priv->errors, E_THEN_EXPECTED, token->line, 
         this->priv->last_label);
-    token->destroy (token);
   }
 
   /* parse the conditional statement */
   if (! this->priv->errors->get_code (this->priv->errors))
     statement->statement.ifn->statement = parse_statement ();
 
-  /* destroy the half-made statement if errors occurred */
-  if (this->priv->errors->get_code (this->priv->errors)) {
-    statement_destroy (statement);
+  /* abandon the half-made statement if errors occurred */
+  if (this->priv->errors->get_code (this->priv->errors))
     statement = NULL;
-  }
 
   /* return the statement */
   return statement;
@@ -488,10 +500,8 @@ static StatementNode *parse_goto_statement (void) {
   statement->statement.goton = statement_create_goto ();
 
   /* parse the line label expression */
-  if (! (statement->statement.goton->label = parse_expression ())) {
-    statement_destroy (statement);
+  if (! (statement->statement.goton->label = parse_expression ()))
     statement = NULL;
-  }
 
   /* return the new statement */
   return statement;
@@ -513,10 +523,8 @@ static StatementNode *parse_gosub_statement (void) {
   statement->statement.gosubn = statement_create_gosub ();
 
   /* parse the line label expression */
-  if (! (statement->statement.gosubn->label = parse_expression ())) {
-    statement_destroy (statement);
+  if (! (statement->statement.gosubn->label = parse_expression ()))
     statement = NULL;
-  }
 
   /* return the new statement */
   return statement;
@@ -554,7 +562,7 @@ static StatementNode *parse_end_statement (void) {
 static StatementNode *parse_print_statement (void) {
 
   /* local variables */
-  Token *token = NULL; /* tokens read as part of the statement */
+  TokenRecord *token = NULL; /* tokens read as part of the statement */
   StatementNode *statement; /* the statement we're building */
   int line; /* line containing the PRINT token */
   OutputNode
@@ -566,51 +574,43 @@ static StatementNode *parse_print_statement (void) {
   statement = statement_create ();
   statement->class = STATEMENT_PRINT;
   statement->statement.printn = statement_create_print ();
-  line = this->priv->stream->get_line (this->priv->stream);
+  line = this->priv->current_line;
 
   /* main loop for parsing the output list */
   do {
 
     /* discard a previous comma, and read the next output value */
-    if (token)
-      token->destroy (token);
     token = get_token_to_parse ();
 
     /* process a premature end of line */
-    if (token->get_class (token) == TOKEN_EOF
-      || token->get_class (token) == TOKEN_EOL) {
+    if (token->class == TOKEN_EOF
+      || token->class == TOKEN_EOL) {
       this->priv->errors->set_code
         (this->priv->errors, E_INVALID_PRINT_OUTPUT, line,
         this->priv->last_label);
-      statement_destroy (statement);
       statement = NULL;
-      token->destroy (token);
     }
 
     /* process a literal string */
-    else if (token->get_class (token) == TOKEN_STRING) {
-      nextoutput = malloc (sizeof (OutputNode));
+    else if (token->class == TOKEN_STRING) {
+      nextoutput = arena_allocate (sizeof (OutputNode));
       nextoutput->class = OUTPUT_STRING;
-      nextoutput->output.string = malloc
-	(1 + strlen (token->get_content (token)));
-      strcpy (nextoutput->output.string, token->get_content (token));
+      nextoutput->output.string = copy_string (token);
       nextoutput->next = NULL;
-      token->destroy (token);
     }
 
     /* attempt to process an expression */
     else {
-      this->priv->stored_token = token;
+      unget_token ();
       if ((expression = parse_expression ())) {
-        nextoutput = malloc (sizeof (OutputNode));
+        nextoutput = arena_allocate (sizeof (OutputNode));
         nextoutput->class = OUTPUT_EXPRESSION;
         nextoutput->output.expression = expression;
         nextoutput->next = NULL;
       } else {
         this->priv->errors->set_code
-          (this->priv->errors, E_INVALID_PRINT_OUTPUT, token->get_line (token),
+          (this->priv->errors, E_INVALID_PRINT_OUTPUT, token->line,
              this->priv->last_label);
-        statement_destroy (statement);
         statement = NULL;
       }
     }
@@ -627,11 +627,11 @@ static StatementNode *parse_print_statement (void) {
 
   /* continue the loop until the statement appears to be finished */
   } while (! this->priv->errors->get_code (this->priv->errors)
-    && token->get_class (token) == TOKEN_COMMA);
+    && token->class == TOKEN_COMMA);
 
   /* push back the last token and return the assembled statement */
   if (! this->priv->errors->get_code (this->priv->errors))
-    this->priv->stored_token = token;
+    unget_token ();
   return statement;
 }
 
@@ -643,7 +643,7 @@ static StatementNode *parse_print_statement (void) {
 static StatementNode *parse_input_statement (void) {
 
   /* local variables */
-  Token *token = NULL; /* tokens read as part of the statement */
+  TokenRecord *token = NULL; /* tokens read as part of the statement */
   StatementNode *statement; /* the statement we're building */
   int line; /* line containing the INPUT token */
   VariableListNode
@@ -654,36 +654,32 @@ static StatementNode *parse_input_statement (void) {
   statement = statement_create ();
   statement->class = STATEMENT_INPUT;
   statement->statement.inputn = statement_create_input ();
-  line = this->priv->stream->get_line (this->priv->stream);
+  line = this->priv->current_line;
 
   /* main loop for parsing the variable list */
   do {
 
     /* discard a previous comma, and seek the next variable */
-    if (token) token->destroy (token);
     token = get_token_to_parse ();
 
     /* process a premature end of line */
-    if (token->get_class (token) == TOKEN_EOF
-      || token->get_line (token) != line) {
+    if (token->class == TOKEN_EOF
+      || token->line != line) {
       this->priv->errors->set_code
         (this->priv->errors, E_INVALID_VARIABLE, line, this->priv->last_label);
-      statement_destroy (statement);
       statement = NULL;
     }
 
     /* attempt to process an variable name */
-    else if (token->get_class (token) != TOKEN_VARIABLE) {
+    else if (token->class != TOKEN_VARIABLE) {
       this->priv->errors->set_code
-        (this->priv->errors, E_INVALID_VARIABLE, token->get_line (token),
+        (this->priv->errors, E_INVALID_VARIABLE, token->line,
 	this->priv->last_label);
-      statement_destroy (statement);
       statement = NULL;
     } else {
-      nextvar = malloc (sizeof (VariableListNode));
-      nextvar->variable = *token->get_content (token) & 0x1f;
+      nextvar = arena_allocate (sizeof (VariableListNode));
+      nextvar->variable = *token->content & 0x1f;
       nextvar->next = NULL;
-      token->destroy (token);
     }
 
     /* add this variable to the statement and look for another */
@@ -696,10 +692,10 @@ static StatementNode *parse_input_statement (void) {
       token = get_token_to_parse ();
     }
   } while (! this->priv->errors->get_code (this->priv->errors)
-    && token->get_class (token) == TOKEN_COMMA);
+    && token->class == TOKEN_COMMA);
 
   /* return the assembled statement */
-  this->priv->stored_token = token;
+  unget_token ();
   return statement;
 }
 
@@ -711,55 +707,46 @@ static StatementNode *parse_input_statement (void) {
 static StatementNode *parse_statement () {
 
   /* local variables */
-  Token *token; /* token read */
+  TokenRecord *token; /* token read */
   StatementNode *statement = NULL; /* the new statement */
 
   /* get the next token */
   token = get_token_to_parse ();
 
   /* check for command */
-  switch (token->get_class (token)) {
+  switch (token->class) {
     case TOKEN_EOL:
-      this->priv->stored_token = token;
+      unget_token ();
       statement = NULL;
       break;
     case TOKEN_LET:
-      token->destroy (token);
       statement = parse_let_statement ();
       break;
     case TOKEN_IF:
-      token->destroy (token);
       statement = parse_if_statement ();
       break;
     case TOKEN_GOTO:
-      token->destroy (token);
       statement = parse_goto_statement ();
       break;
     case TOKEN_GOSUB:
-      token->destroy (token);
       statement = parse_gosub_statement ();
       break;
     case TOKEN_RETURN:
-      token->destroy (token);
       statement = parse_return_statement ();
       break;
     case TOKEN_END:
-      token->destroy (token);
       statement = parse_end_statement ();
       break;
     case TOKEN_PRINT:
-      token->destroy (token);
       statement = parse_print_statement ();
       break;
     case TOKEN_INPUT:
-      token->destroy (token);
       statement = parse_input_statement ();
       break;
     default:
       this->priv->errors->set_code
-        (this->priv->errors, E_UNRECOGNISED_COMMAND, token->get_line (token),
+        (this->priv->errors, E_UNRECOGNISED_COMMAND, token->line,
         this->priv->last_label);
-      token->destroy (token);
   }
 
   /* return the statement */
@@ -774,7 +761,7 @@ static StatementNode *parse_statement () {
 static ProgramLineNode *parse_program_line (void) {
 
   /* local variables */
-  Token *token; /* token read */
+  TokenRecord *token; /* token read */
   ProgramLineNode *program_line; /* program line read */
   int label_encountered = 0; /* 1 if this line has an explicit label */
 
@@ -782,28 +769,25 @@ static ProgramLineNode *parse_program_line (void) {
   program_line = program_line_create ();
   program_line->label = generate_default_label ();
   token = get_token_to_parse ();
+  program_line->source_line = token->line;
 
   /* deal with end of file */
-  if (token->get_class (token) == TOKEN_EOF) {
-    token->destroy (token);
-    program_line_destroy (program_line);
+  if (token->class == TOKEN_EOF) {
     return NULL;
   }
 
   /* deal with line label, if supplied */
-  if (token->get_class (token) == TOKEN_NUMBER) {
-    program_line->label = atoi (token->get_content (token));
+  if (token->class == TOKEN_NUMBER) {
+    program_line->label = atoi (token->content);
     label_encountered = 1;
-    token->destroy (token);
   } else
-    this->priv->stored_token = token;
+    unget_token ();
 
   /* validate the supplied or implied line label */
   if (! validate_line_label (program_line->label)) {
     this->priv->errors->set_code
       (this->priv->errors, E_INVALID_LINE_NUMBER, this->priv->current_line,
       program_line->label);
-    program_line_destroy (program_line);
     return NULL;
   }
   if (label_encountered)
@@ -813,12 +797,11 @@ static ProgramLineNode *parse_program_line (void) {
   program_line->statement = parse_statement ();
   if (! this->priv->errors->get_code (this->priv->errors)) {
     token = get_token_to_parse ();
-    if (token->get_class (token) != TOKEN_EOL
-      && token->get_class (token) != TOKEN_EOF)
+    if (token->class != TOKEN_EOL
+      && token->class != TOKEN_EOF)
       this->priv->errors->set_code
         (this->priv->errors, E_UNEXPECTED_PARAMETER, this->priv->current_line,
         this->priv->last_label);
-    token->destroy (token);
   }
   if (program_line->statement)
     this->priv->last_label = program_line->label;
@@ -834,13 +817,16 @@ static ProgramLineNode *parse_program_line (void) {
 
 
 /*
- * Parse the whole program
+ * Parse a whole program from an array of tokens
  * params:
- *   Parser*   parser   The parser to use
+ *   Parser*        parser   The parser to use
+ *   TokenRecord*   tokens   The tokens, the last of which is TOKEN_EOF
+ *   int            count    The number of tokens
  * returns:
- *   ProgramNode*       The parsed program
+ *   ProgramNode*            The parsed program
  */
-static ProgramNode *parse (Parser *parser) {
+static ProgramNode *parse_tokens (Parser *parser, TokenRecord *tokens,
+  int count) {
 
   /* local varables */
   ProgramNode *program; /* the stored program */
@@ -850,8 +836,10 @@ static ProgramNode *parse (Parser *parser) {
 
   /* initialise the program */
   this = parser;
-  program = malloc (sizeof (ProgramNode));
-  program->first = NULL;
+  this->priv->tokens = tokens;
+  this->priv->token_count = count;
+  this->priv->next_token = 0;
+  program = program_create ();
 
   /* read lines until reaching an error or end of input */
   while ((current = parse_program_line ())
@@ -863,6 +851,30 @@ static ProgramNode *parse (Parser *parser) {
     previous = current;
   }
 
+  /* return the program */
+  this->priv->tokens = NULL;
+  return program;
+}
+
+/*
+ * Parse the whole program from the input file
+ * params:
+ *   Parser*   parser   The parser to use
+ * returns:
+ *   ProgramNode*       The parsed program
+ */
+static ProgramNode *parse (Parser *parser) {
+
+  /* local variables */
+  TokenRecord *tokens; /* the tokens in the input file */
+  int count; /* the number of tokens */
+  ProgramNode *program; /* the parsed program */
+
+  /* tokenise the whole file, then parse the tokens */
+  tokens = parser->priv->stream->read_all (parser->priv->stream, &count);
+  program = parse_tokens (parser, tokens, count);
+  free (tokens);
+
   /* return the program */
   return program;
 }
@@ -916,7 +928,7 @@ void destroy (Parser *parser) {
  * params:
  *   ErrorHandler*      errors    the error handler to use
  *   LanguageOptions*   options   the language options to use
- *   FILE*              input     the input file
+ *   FILE*              input     the input file, or NULL to parse tokens
  * returns:
  *   Parser*                      the new parser
  */
@@ -926,10 +938,11 @@ Parser *new_Parser (ErrorHandler *errors, LanguageOptions *options,
   /* allocate memory */
   this = malloc (sizeof (Parser));
   this->priv = malloc (sizeof (ParserData));
-  this->priv->stream = new_TokenStream (input);
+  this->priv->stream = input ? new_TokenStream (input) : NULL;
 
   /* initialise methods */
   this->parse = parse;
+  this->parse_tokens = parse_tokens;
   this->get_line = get_line;
   this->get_label = get_label;
   this->destroy = destroy;
@@ -938,7 +951,9 @@ Parser *new_Parser (ErrorHandler *errors, LanguageOptions *options,
   this->priv->last_label = 0;
   this->priv->current_line = 0;
   this->priv->end_of_file = 0;
-  this->priv->stored_token = NULL;
+  this->priv->tokens = NULL;
+  this->priv->token_count = 0;
+  this->priv->next_token = 0;
   this->priv->errors = errors;
   this->priv->options = options;
 
@@ -0,0 +1,304 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * Line Profiler Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profile.h"
+#include "statement.h"
+
+
+/*
+ * Level 2 Routines
+ */
+
+
+/*
+ * Compare two profile entries for sorting, busiest first
+ * params:
+ *   const void*   a   the first entry
+ *   const void*   b   the second entry
+ * returns:
+ *   int               <0 if a comes first, >0 if b comes first
+ */
+static int compare_entries (const void *a, const void *b) {
+  const ProfileEntry
+    *entry_a = *(ProfileEntry *const *) a, /* the first entry */
+    *entry_b = *(ProfileEntry *const *) b; /* the second entry */
+  if (entry_a->self_time != entry_b->self_time)
+    return (entry_a->self_time < entry_b->self_time)
+      - (entry_a->self_time > entry_b->self_time);
+  if (entry_a->count != entry_b->count)
+    return (entry_a->count < entry_b->count)
+      - (entry_a->count > entry_b->count);
+  return (entry_a->line->source_line > entry_b->line->source_line)
+    - (entry_a->line->source_line < entry_b->line->source_line);
+}
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Convert a clock interval to seconds
+ * params:
+ *   clock_t   interval   the interval to convert
+ * returns:
+ *   double               the interval in seconds
+ */
+static double seconds (clock_t interval) {
+  return (double) interval / CLOCKS_PER_SEC;
+}
+
+/*
+ * List the entries for lines that were executed, busiest first
+ * params:
+ *   Profile*   profile   the profile to list
+ *   int*       count     the number of entries listed
+ * returns:
+ *   ProfileEntry**       the sorted list, which the caller frees
+ */
+static ProfileEntry **sorted_entries (Profile *profile, int *count) {
+
+  /* local variables */
+  ProfileEntry **sorted; /* the sorted list */
+  int entry; /* entry counter */
+
+  /* gather and sort the entries */
+  *count = 0;
+  if (! (sorted = malloc ((profile->entry_count + 1)
+    * sizeof (ProfileEntry *))))
+    return NULL;
+  for (entry = 0; entry < profile->entry_count; ++entry)
+    if (profile->entries [entry].count)
+      sorted [(*count)++] = &profile->entries [entry];
+  qsort (sorted, *count, sizeof (ProfileEntry *), compare_entries);
+  return sorted;
+}
+
+
+/*
+ * Public Functions
+ */
+
+
+/*
+ * Create an empty profile for a program
+ * params:
+ *   ProgramNode*   program   the program to be profiled
+ * returns:
+ *   Profile*                 the new profile
+ */
+Profile *profile_create (ProgramNode *program) {
+
+  /* local variables */
+  Profile *profile; /* the new profile */
+  ProgramLineNode *line; /* line counter */
+  int entry; /* entry counter */
+
+  /* allocate an entry for every source line */
+  if (! (profile = malloc (sizeof (Profile))))
+    return NULL;
+  profile->entry_count = 0;
+  for (line = program->first; line; line = line->next)
+    if (line->source_line >= profile->entry_count)
+      profile->entry_count = line->source_line + 1;
+  profile->entries = malloc ((profile->entry_count + 1)
+    * sizeof (ProfileEntry));
+  for (entry = 0; entry < profile->entry_count; ++entry) {
+    profile->entries [entry].line = NULL;
+    profile->entries [entry].count = 0;
+    profile->entries [entry].self_time = 0;
+    profile->entries [entry].calls = 0;
+    profile->entries [entry].call_time = 0;
+    profile->entries [entry].active = 0;
+  }
+  for (line = program->first; line; line = line->next)
+    profile->entries [line->source_line].line = line;
+
+  /* initialise the call stack and the totals */
+  profile->calls = NULL;
+  profile->call_starts = NULL;
+  profile->call_depth = 0;
+  profile->call_capacity = 0;
+  profile->statements = 0;
+  profile->total_time = 0;
+
+  /* return the new profile */
+  return profile;
+}
+
+/*
+ * Record the execution of a program line
+ * params:
+ *   Profile*           profile   the profile to record in
+ *   ProgramLineNode*   line      the line executed
+ *   clock_t            elapsed   the time the line took
+ */
+void profile_statement (Profile *profile, ProgramLineNode *line,
+  clock_t elapsed) {
+  ProfileEntry *entry; /* the line's entry */
+  entry = &profile->entries [line->source_line];
+  ++entry->count;
+  entry->self_time += elapsed;
+  ++profile->statements;
+  profile->total_time += elapsed;
+}
+
+/*
+ * Record a GOSUB entering a subroutine
+ * params:
+ *   Profile*           profile   the profile to record in
+ *   ProgramLineNode*   target    the first line of the subroutine
+ *   clock_t            now       the time the subroutine was entered
+ */
+void profile_call (Profile *profile, ProgramLineNode *target, clock_t now) {
+
+  /* make room on the call stack */
+  if (profile->call_depth == profile->call_capacity) {
+    profile->call_capacity = profile->call_capacity
+      ? 2 * profile->call_capacity
+      : 16;
+    profile->calls = realloc (profile->calls,
+      profile->call_capacity * sizeof (ProfileEntry *));
+    profile->call_starts = realloc (profile->call_starts,
+      profile->call_capacity * sizeof (clock_t));
+  }
+
+  /* push the subroutine, which is unknown if the GOSUB failed */
+  profile->calls [profile->call_depth] = target
+    ? &profile->entries [target->source_line]
+    : NULL;
+  if (target)
+    ++profile->calls [profile->call_depth]->active;
+  profile->call_starts [profile->call_depth++] = now;
+}
+
+/*
+ * Record a RETURN from the most recent subroutine
+ * The time is counted only when the outermost activation of a recursive
+ * subroutine returns, since it includes that of the inner activations.
+ * params:
+ *   Profile*   profile   the profile to record in
+ *   clock_t    now       the time the subroutine returned
+ */
+void profile_return (Profile *profile, clock_t now) {
+  ProfileEntry *entry; /* the subroutine's entry */
+  if (! profile->call_depth)
+    return;
+  --profile->call_depth;
+  if ((entry = profile->calls [profile->call_depth])) {
+    ++entry->calls;
+    if (! --entry->active)
+      entry->call_time += now - profile->call_starts [profile->call_depth];
+  }
+}
+
+/*
+ * Close any subroutines still active when the program stops
+ * params:
+ *   Profile*   profile   the profile to finish
+ *   clock_t    now       the time the program stopped
+ */
+void profile_finish (Profile *profile, clock_t now) {
+  while (profile->call_depth)
+    profile_return (profile, now);
+}
+
+/*
+ * Write a text report, busiest lines first
+ * params:
+ *   Profile*   profile   the profile to report
+ *   FILE*      output    the stream to write to
+ */
+void profile_write_text (Profile *profile, FILE *output) {
+
+  /* local variables */
+  ProfileEntry **sorted; /* the entries in report order */
+  int count, /* the number of entries */
+    entry; /* entry counter */
+  double share; /* the entry's share of the total time */
+
+  /* write the summary and the column headings */
+  if (! (sorted = sorted_entries (profile, &count)))
+    return;
+  fprintf (output, "%ld statements executed in %.6f s\n\n",
+    profile->statements, seconds (profile->total_time));
+  fprintf (output, "%6s %6s %10s %10s %6s %8s %10s\n",
+    "Line", "Label", "Count", "Self s", "Self%", "Calls", "Incl s");
+
+  /* write a row for each line that was executed */
+  for (entry = 0; entry < count; ++entry) {
+    share = profile->total_time
+      ? 100.0 * sorted [entry]->self_time / profile->total_time
+      : 0.0;
+    fprintf (output, "%6d %6d %10ld %10.6f %5.1f%%",
+      sorted [entry]->line->source_line, sorted [entry]->line->label,
+      sorted [entry]->count, seconds (sorted [entry]->self_time), share);
+    if (sorted [entry]->calls)
+      fprintf (output, " %8ld %10.6f\n",
+        sorted [entry]->calls, seconds (sorted [entry]->call_time));
+    else
+      fprintf (output, " %8s %10s\n", "-", "-");
+  }
+  free (sorted);
+}
+
+/*
+ * Write a JSON report, busiest lines first
+ * params:
+ *   Profile*   profile   the profile to report
+ *   FILE*      output    the stream to write to
+ */
+void profile_write_json (Profile *profile, FILE *output) {
+
+  /* local variables */
+  ProfileEntry **sorted; /* the entries in report order */
+  int count, /* the number of entries */
+    entry; /* entry counter */
+
+  /* write the summary */
+  if (! (sorted = sorted_entries (profile, &count)))
+    return;
+  fprintf (output, "{\n  \"statements\": %ld,\n  \"seconds\": %.6f,\n",
+    profile->statements, seconds (profile->total_time));
+
+  /* write an object for each line that was executed */
+  fprintf (output, "  \"lines\": [");
+  for (entry = 0; entry < count; ++entry)
+    fprintf (output, "%s\n    {\"line\": %d, \"label\": %d, \"count\": %ld, "
+      "\"self_seconds\": %.6f, \"calls\": %ld, \"inclusive_seconds\": %.6f}",
+      entry ? "," : "",
+      sorted [entry]->line->source_line, sorted [entry]->line->label,
+      sorted [entry]->count, seconds (sorted [entry]->self_time),
+      sorted [entry]->calls, seconds (sorted [entry]->call_time));
+  fprintf (output, "%s]\n}\n", count ? "\n  " : "");
+  free (sorted);
+}
+
+/*
+ * Destroy a profile
+ * params:
+ *   Profile*   profile   the doomed profile
+ */
+void profile_destroy (Profile *profile) {
+  if (profile) {
+    if (profile->entries)
+      free (profile->entries);
+    if (profile->calls)
+      free (profile->calls);
+    if (profile->call_starts)
+      free (profile->call_starts);
+    free (profile);
+  }
+}
@@ -13,6 +13,151 @@
 #include <string.h>
 #include <ctype.h>
 #include "statement.h"
+#include "arena.h"
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Apply an action to each expression in a statement
+ * params:
+ *   StatementNode*   statement   the statement to process
+ *   void (*)(ExpressionNode*)    action      the action to apply
+ */
+static void process_expressions (StatementNode *statement,
+  void (*action) (ExpressionNode *)) {
+
+  /* local variables */
+  OutputNode *output; /* an item in a PRINT list */
+
+  /* comments have no expressions */
+  if (! statement)
+    return;
+
+  /* process the expressions of each statement class */
+  switch (statement->class) {
+    case STATEMENT_LET:
+      action (statement->statement.letn->expression);
+      break;
+    case STATEMENT_IF:
+      action (statement->statement.ifn->left);
+      action (statement->statement.ifn->right);
+      process_expressions (statement->statement.ifn->statement, action);
+      break;
+    case STATEMENT_GOTO:
+      action (statement->statement.goton->label);
+      break;
+    case STATEMENT_GOSUB:
+      action (statement->statement.gosubn->label);
+      break;
+    case STATEMENT_PRINT:
+      for (output = statement->statement.printn->first; output;
+        output = output->next)
+        if (output->class == OUTPUT_EXPRESSION)
+          action (output->output.expression);
+      break;
+    default:
+      break;
+  }
+}
+
+
+/*
+ * Fuse a LET statement of the form variable=variable+operand
+ * params:
+ *   StatementNode*   statement   the LET statement
+ */
+static void fuse_let (StatementNode *statement) {
+
+  /* local variables */
+  LetStatementNode *letn; /* the LET statement details */
+  ExpressionOp *ops; /* the operations of its expression */
+  StepStatementNode *stepn; /* the fused statement */
+  int operand; /* the index of the operand stepped by */
+
+  /* look for V+operand, V-operand or operand+V, with a simple operand */
+  letn = statement->statement.letn;
+  ops = letn->expression->ops;
+  if (letn->expression->op_count != 3
+    || (ops [2].op != EXPRESSION_OP_ADD
+      && ops [2].op != EXPRESSION_OP_SUBTRACT))
+    return;
+  if (ops [0].op == EXPRESSION_OP_VARIABLE
+    && ops [0].operand == letn->variable
+    && (ops [1].op == EXPRESSION_OP_VALUE
+      || ops [1].op == EXPRESSION_OP_VARIABLE))
+    operand = 1;
+  else if (ops [2].op == EXPRESSION_OP_ADD
+    && ops [1].op == EXPRESSION_OP_VARIABLE
+    && ops [1].operand == letn->variable
+    && (ops [0].op == EXPRESSION_OP_VALUE
+      || ops [0].op == EXPRESSION_OP_VARIABLE))
+    operand = 0;
+  else
+    return;
+
+  /* replace the statement */
+  stepn = statement_create_step ();
+  stepn->variable = letn->variable;
+  stepn->operand = ops [operand];
+  stepn->subtract = (ops [2].op == EXPRESSION_OP_SUBTRACT);
+  statement->class = STATEMENT_STEP;
+  statement->statement.stepn = stepn;
+}
+
+/*
+ * Fuse an IF statement comparing simple operands, then going to a line
+ * params:
+ *   StatementNode*   statement   the IF statement
+ */
+static void fuse_if (StatementNode *statement) {
+
+  /* local variables */
+  IfStatementNode *ifn; /* the IF statement details */
+  IfGotoStatementNode *ifgoton; /* the fused statement */
+
+  /* only values and variables may be compared, and the GOTO be linked */
+  ifn = statement->statement.ifn;
+  if (ifn->left->op_count != 1
+    || ifn->right->op_count != 1
+    || ! ifn->statement
+    || ifn->statement->class != STATEMENT_GOTO
+    || ! ifn->statement->statement.goton->target)
+    return;
+
+  /* replace the statement */
+  ifgoton = statement_create_if_goto ();
+  ifgoton->left = ifn->left->ops [0];
+  ifgoton->op = ifn->op;
+  ifgoton->right = ifn->right->ops [0];
+  ifgoton->target = ifn->statement->statement.goton->target;
+  statement->class = STATEMENT_IF_GOTO;
+  statement->statement.ifgoton = ifgoton;
+}
+
+/*
+ * Fuse a statement, and any statement nested in it, if it can be fused
+ * params:
+ *   StatementNode*   statement   the statement to fuse
+ */
+static void fuse_statement (StatementNode *statement) {
+  if (! statement)
+    return;
+  switch (statement->class) {
+    case STATEMENT_LET:
+      fuse_let (statement);
+      break;
+    case STATEMENT_IF:
+      fuse_statement (statement->statement.ifn->statement);
+      fuse_if (statement);
+      break;
+    default:
+      break;
+  }
+}
 
 
 /*
@@ -31,7 +176,7 @@ LetStatementNode *statement_create_let (void) {
   LetStatementNode *letn; /* the created node */
 
   /* allocate memory and assign safe defaults */
-  letn = malloc (sizeof (LetStatementNode));
+  letn = arena_allocate (sizeof (LetStatementNode));
   letn->variable = 0;
   letn->expression = NULL;
 
@@ -39,17 +184,6 @@ LetStatementNode *statement_create_let (void) {
   return letn;
 }
 
-/*
- * Destructor for a LET statement
- * params:
- *   LetStatementNode   *letn   the doomed LET statement.
- */
-void statement_destroy_let (LetStatementNode *letn) {
-  if (letn->expression)
-    expression_destroy (letn->expression);
-  free (letn);
-}
-
 
 /*
  * IF Statement Functions
@@ -67,7 +201,7 @@ IfStatementNode *statement_create_if (void) {
   IfStatementNode *ifn; /* the created node */
 
   /* allocate memory and assign safe defaults */
-  ifn = malloc (sizeof (IfStatementNode));
+  ifn = arena_allocate (sizeof (IfStatementNode));
   ifn->left = ifn->right = NULL;
   ifn->op = RELOP_EQUAL;
   ifn->statement = NULL;
@@ -76,21 +210,6 @@ IfStatementNode *statement_create_if (void) {
   return ifn;
 }
 
-/*
- * IF statement destructor
- * params:
- *   IfStatementNode*   ifn   the doomed IF statement
- */
-void statement_destroy_if (IfStatementNode *ifn) {
-  if (ifn->left)
-    expression_destroy (ifn->left);
-  if (ifn->right)
-    expression_destroy (ifn->right);
-  if (ifn->statement)
-    statement_destroy (ifn->statement);
-  free (ifn);
-}
-
 
 /*
  * GOTO Statement Functions
@@ -108,26 +227,14 @@ GotoStatementNode *statement_create_goto (void) {
   GotoStatementNode *goton; /* the statement to create */
 
   /* create and initialise the data */
-  goton = malloc (sizeof (GotoStatementNode));
+  goton = arena_allocate (sizeof (GotoStatementNode));
   goton->label = NULL;
+  goton->target = NULL;
 
   /* return the goto statement */
   return goton;
 }
 
-/*
- * GOTO Statement Destructor
- * params:
- *   GotoStatementNode*   goton   the doomed GOTO statement
- */
-void statement_destroy_goto (GotoStatementNode *goton) {
-  if (goton) {
-    if (goton->label)
-      expression_destroy (goton->label);
-    free (goton);
-  }
-}
-
 
 /*
  * GOSUB Statement Functions
@@ -145,26 +252,14 @@ GosubStatementNode *statement_create_gosub (void) {
   GosubStatementNode *gosubn; /* the statement to create */
 
   /* create and initialise the data */
-  gosubn = malloc (sizeof (GosubStatementNode));
+  gosubn = arena_allocate (sizeof (GosubStatementNode));
   gosubn->label = NULL;
+  gosubn->target = NULL;
 
   /* return the gosub statement */
   return gosubn;
 }
 
-/*
- * GOSUB Statement Destructor
- * params:
- *   GosubStatementNode*   gosubn   the doomed GOSUB statement
- */
-void statement_destroy_gosub (GosubStatementNode *gosubn) {
-  if (gosubn) {
-    if (gosubn->label)
-      expression_destroy (gosubn->label);
-    free (gosubn);
-  }
-}
-
 
 /*
  * PRINT Statement Functions
@@ -182,33 +277,13 @@ PrintStatementNode *statement_create_print (void) {
   PrintStatementNode *printn; /* the created node */
 
   /* allocate memory and assign safe defaults */
-  printn = malloc (sizeof (PrintStatementNode));
+  printn = arena_allocate (sizeof (PrintStatementNode));
   printn->first = NULL;
 
   /* return the PRINT statement node */
   return printn;
 }
 
-/*
- * Destructor for a PRINT statement
- * params:
- *   PrintStatementNode   *printn   the doomed PRINT statement.
- */
-void statement_destroy_print (PrintStatementNode *printn) {
-  OutputNode *current, *next;
-  current = printn->first;
-  while (current) {
-    next = current->next;
-    if (current->class == OUTPUT_STRING)
-      free (current->output.string);
-    else if (current->class == OUTPUT_EXPRESSION)
-      expression_destroy (current->output.expression);
-    free (current);
-    current = next;
-  }
-  free (printn);
-}
-
 
 /*
  * INPUT Statement Functions
@@ -226,35 +301,59 @@ InputStatementNode *statement_create_input (void) {
   InputStatementNode *inputn; /* the new input statement data */
 
   /* allocate memory and initalise safely */
-  inputn = malloc (sizeof (InputStatementNode));
+  inputn = arena_allocate (sizeof (InputStatementNode));
   inputn->first = NULL;
 
   /* return the created node */
   return inputn;
 }
 
+
 /*
- * INPUT statement destructor
- * params:
- *   InputStatementNode*   inputn   the doomed INPUT statement node
+ * Fused Statement Functions
+ */
+
+
+/*
+ * Step statement constructor
+ * returns:
+ *   StepStatementNode*   the created step statement
  */
-void statement_destroy_input (InputStatementNode *inputn) {
+StepStatementNode *statement_create_step (void) {
 
   /* local variables */
-  VariableListNode
-    *variable, /* the current variable to destroy */
-    *next; /* the next variable to destroy */
-
-  /* delete the variables from the variable list, then the input node */
-  if (inputn) {
-    variable = inputn->first;
-    while (variable) {
-      next = variable->next;
-      free (variable);
-      variable = next;
-    }
-    free (inputn);
-  }
+  StepStatementNode *stepn; /* the created node */
+
+  /* allocate memory and assign safe defaults */
+  stepn = arena_allocate (sizeof (StepStatementNode));
+  stepn->variable = 0;
+  stepn->operand.op = EXPRESSION_OP_VALUE;
+  stepn->operand.operand = 0;
+  stepn->subtract = 0;
+
+  /* return the step statement node */
+  return stepn;
+}
+
+/*
+ * IF-GOTO statement constructor
+ * returns:
+ *   IfGotoStatementNode*   the created IF-GOTO statement
+ */
+IfGotoStatementNode *statement_create_if_goto (void) {
+
+  /* local variables */
+  IfGotoStatementNode *ifgoton; /* the created node */
+
+  /* allocate memory and assign safe defaults */
+  ifgoton = arena_allocate (sizeof (IfGotoStatementNode));
+  ifgoton->left.op = ifgoton->right.op = EXPRESSION_OP_VALUE;
+  ifgoton->left.operand = ifgoton->right.operand = 0;
+  ifgoton->op = RELOP_EQUAL;
+  ifgoton->target = NULL;
+
+  /* return the IF-GOTO statement node */
+  return ifgoton;
 }
 
 
@@ -274,44 +373,13 @@ StatementNode *statement_create (void) {
   StatementNode *statement; /* the created statement */
 
   /* allocate memory and set defaults */
-  statement = malloc (sizeof (StatementNode));
+  statement = arena_allocate (sizeof (StatementNode));
   statement->class = STATEMENT_NONE;
 
   /* return the created statement */
   return statement;
 }
 
-/*
- * Statement destructor
- * params:
- *   StatementNode*   statement   the doomed statement
- */
-void statement_destroy (StatementNode *statement) {
-  switch (statement->class) {
-    case STATEMENT_LET:
-      statement_destroy_let (statement->statement.letn);
-      break;
-    case STATEMENT_PRINT:
-      statement_destroy_print (statement->statement.printn);
-      break;
-    case STATEMENT_INPUT:
-      statement_destroy_input (statement->statement.inputn);
-      break;
-    case STATEMENT_IF:
-      statement_destroy_if (statement->statement.ifn);
-      break;
-    case STATEMENT_GOTO:
-      statement_destroy_goto (statement->statement.goton);
-      break;
-    case STATEMENT_GOSUB:
-      statement_destroy_gosub (statement->statement.gosubn);
-      break;
-    default:
-      break;
-  }
-  free (statement);
-}
-
 
 /*
  * Program Line Constructor
@@ -324,8 +392,9 @@ ProgramLineNode *program_line_create (void) {
   ProgramLineNode *program_line; /* the program line to create */
 
   /* create and initialise the program line */
-  program_line = malloc (sizeof (ProgramLineNode));
+  program_line = arena_allocate (sizeof (ProgramLineNode));
   program_line->label = 0;
+  program_line->source_line = 0;
   program_line->statement = NULL;
   program_line->next = NULL;
 
@@ -333,32 +402,9 @@ ProgramLineNode *program_line_create (void) {
   return program_line;
 }
 
-/*
- * Program Line Destructor
- * params:
- *   ProgramLineNode*   program_line   the doomed program line
- * params:
- *   ProgramLineNode*                  the next program line
- */
-ProgramLineNode *program_line_destroy (ProgramLineNode *program_line) {
-
-  /* local variables */
-  ProgramLineNode *next = NULL; /* the next program line */
-
-  /* record the next line and destroy this one */
-  if (program_line) {
-    next = program_line->next;
-    if (program_line->statement)
-      statement_destroy (program_line->statement);
-    free (program_line);
-  }
-
-  /* return the line following */
-  return next;
-}
-
 /*
  * Program Constructor
+ * The new program's arena is selected for the nodes that follow.
  * returns:
  *   ProgramNode*   the constructed program
  */
@@ -367,14 +413,63 @@ ProgramNode *program_create (void) {
   /* local variables */
   ProgramNode *program; /* new program */
 
-  /* create and initialise the program */
-  program = malloc (sizeof (program));
+  /* create the program and the arena that will hold its nodes */
+  program = malloc (sizeof (ProgramNode));
   program->first = NULL;
+  program->arena = arena_create ();
+  arena_select (program->arena);
 
   /* return the new program */
   return program;
 }
 
+/*
+ * Flatten every expression in a program into postfix operations
+ * params:
+ *   ProgramNode*   program   the program to flatten
+ */
+void program_flatten (ProgramNode *program) {
+
+  /* local variables */
+  ProgramLineNode *line; /* the line being flattened */
+
+  /* the operation arrays live alongside the program's other nodes */
+  arena_select (program->arena);
+  for (line = program->first; line; line = line->next)
+    process_expressions (line->statement, expression_flatten);
+}
+
+/*
+ * Fold the constants and remove the identities in a flattened program
+ * params:
+ *   ProgramNode*   program   the program to optimise
+ */
+void program_fold (ProgramNode *program) {
+
+  /* local variables */
+  ProgramLineNode *line; /* the line being optimised */
+
+  /* fold each expression in place */
+  for (line = program->first; line; line = line->next)
+    process_expressions (line->statement, expression_fold);
+}
+
+/*
+ * Replace common statement patterns with fused statements
+ * params:
+ *   ProgramNode*   program   the program to optimise
+ */
+void program_fuse (ProgramNode *program) {
+
+  /* local variables */
+  ProgramLineNode *line; /* the line being optimised */
+
+  /* the fused statements live alongside the program's other nodes */
+  arena_select (program->arena);
+  for (line = program->first; line; line = line->next)
+    fuse_statement (line->statement);
+}
+
 /*
  * Program Destructor
  * params:
@@ -382,12 +477,7 @@ ProgramNode *program_create (void) {
  */
 void program_destroy (ProgramNode *program) {
 
-  /* local variables */
-  ProgramLineNode *program_line; /* the program line to destroy */
-
-  /* destroy the program lines, then the program itself */
-  program_line = program->first;
-  while (program_line)
-    program_line = program_line_destroy (program_line);
+  /* all of the program's nodes are freed along with its arena */
+  arena_destroy (program->arena);
   free (program);
 }
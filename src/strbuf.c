@@ -0,0 +1,146 @@
+/*
+ * Tiny BASIC Interpreter and Compiler Project
+ * String Buffer Module
+ *
+ * Released as Public Domain by Damian Gareth Walker 2019
+ * Created: 17-Oct-2026
+ */
+
+
+/* included headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strbuf.h"
+
+
+/*
+ * Data Definitions
+ */
+
+
+/* the space first allocated for a buffer's text */
+#define STRBUF_INITIAL_CAPACITY 256
+
+
+/*
+ * Level 1 Routines
+ */
+
+
+/*
+ * Make room in a buffer for more text
+ * params:
+ *   StringBuffer*   buffer   the buffer to grow
+ *   size_t          extra    the number of characters to be added
+ */
+static void reserve (StringBuffer *buffer, size_t extra) {
+  if (buffer->length + extra + 1 > buffer->capacity) {
+    while (buffer->length + extra + 1 > buffer->capacity)
+      buffer->capacity *= 2;
+    buffer->text = realloc (buffer->text, buffer->capacity);
+  }
+}
+
+
+/*
+ * Top Level Routines
+ */
+
+
+/*
+ * Create an empty string buffer
+ * returns:
+ *   StringBuffer*   the new buffer
+ */
+StringBuffer *strbuf_create (void) {
+
+  /* local variables */
+  StringBuffer *buffer; /* the new buffer */
+
+  /* allocate memory and initialise members */
+  buffer = malloc (sizeof (StringBuffer));
+  buffer->capacity = STRBUF_INITIAL_CAPACITY;
+  buffer->text = malloc (buffer->capacity);
+  *buffer->text = '\0';
+  buffer->length = 0;
+
+  /* return the buffer */
+  return buffer;
+}
+
+/*
+ * Append text to a string buffer
+ * params:
+ *   StringBuffer*   buffer   the buffer to append to
+ *   char*           text     the text to append
+ */
+void strbuf_append (StringBuffer *buffer, char *text) {
+
+  /* local variables */
+  size_t length; /* the length of the text */
+
+  /* copy the text and its terminator onto the end */
+  length = strlen (text);
+  reserve (buffer, length);
+  memcpy (buffer->text + buffer->length, text, length + 1);
+  buffer->length += length;
+}
+
+/*
+ * Append a single character to a string buffer
+ * params:
+ *   StringBuffer*   buffer   the buffer to append to
+ *   char            ch       the character to append
+ */
+void strbuf_append_char (StringBuffer *buffer, char ch) {
+  reserve (buffer, 1);
+  buffer->text [buffer->length++] = ch;
+  buffer->text [buffer->length] = '\0';
+}
+
+/*
+ * Append an integer in decimal to a string buffer
+ * params:
+ *   StringBuffer*   buffer   the buffer to append to
+ *   int             value    the integer to append
+ */
+void strbuf_append_int (StringBuffer *buffer, int value) {
+
+  /* local variables */
+  char digits[12]; /* the integer as text */
+
+  /* convert the integer and append it */
+  sprintf (digits, "%d", value);
+  strbuf_append (buffer, digits);
+}
+
+/*
+ * Destroy a string buffer, keeping its text
+ * params:
+ *   StringBuffer*   buffer   the doomed buffer
+ * returns:
+ *   char*                    the text, for the caller to free
+ */
+char *strbuf_release (StringBuffer *buffer) {
+
+  /* local variables */
+  char *text; /* the text of the buffer */
+
+  /* free the buffer but not its text */
+  text = buffer->text;
+  free (buffer);
+  return text;
+}
+
+/*
+ * Destroy a string buffer and its text
+ * params:
+ *   StringBuffer*   buffer   the doomed buffer
+ */
+void strbuf_destroy (StringBuffer *buffer) {
+  if (buffer) {
+    free (buffer->text);
+    free (buffer);
+  }
+}
@@ -11,22 +11,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "options.h"
 #include "errors.h"
 #include "parser.h"
 #include "statement.h"
+#include "linker.h"
 #include "interpret.h"
+#include "bytecode.h"
+#include "jit.h"
 #include "formatter.h"
 #include "generatec.h"
+#include "profile.h"
+#include "loader.h"
+
+/* the command compiling a shared object, if TBSO is not set */
+#define DEFAULT_TBSO "cc -shared -fPIC -O2 -o $(TARGET) $(SOURCE)"
 
 /* static variables */
 static char *input_filename = NULL; /* name of the input file */
+static char *data_filename = NULL; /* name of a file of INPUT data */
 static enum { /* action to take with parsed program */
   OUTPUT_INTERPRET, /* interpret the program */
+  OUTPUT_BYTECODE, /* compile the program to bytecode and run it */
+  OUTPUT_JIT, /* compile the program to native code and run it */
   OUTPUT_LST, /* output a formatted listing */
   OUTPUT_C, /* output a C program */
-  OUTPUT_EXE /* output an executable */
+  OUTPUT_EXE, /* output an executable */
+  OUTPUT_RUN /* compile to a cached shared object and run it */
 } output = OUTPUT_INTERPRET;
+static int statistics = 0; /* !0 to report run-time statistics */
+static int profiling = 0; /* !0 to write a line profile of the run */
+static FlushPolicy flush_policy = FLUSH_AUTO; /* when PRINT output is flushed */
+static int fold = 1; /* !0 to fold constant expressions */
+static int tracing = 1; /* !0 to compile hot loops to native code */
 static ErrorHandler *errors; /* universal error handler */
 static LanguageOptions *loptions; /* language options */
 
@@ -91,6 +109,56 @@ static void set_output (char *option) {
     output = OUTPUT_C;
   else if (! strcmp ("exe", option))
     output = OUTPUT_EXE;
+  else if (! strcmp ("b", option))
+    output = OUTPUT_BYTECODE;
+  else if (! strcmp ("j", option))
+    output = OUTPUT_JIT;
+  else if (! strcmp ("run", option))
+    output = OUTPUT_RUN;
+  else
+    errors->set_code (errors, E_BAD_COMMAND_LINE, 0, 0);
+}
+
+/*
+ * Set the constant folding option
+ * params:
+ *   char*   option   the option supplied on the command line
+ */
+static void set_fold (char *option) {
+  if (! strncmp ("enabled", option, strlen (option)))
+    fold = 1;
+  else if (! strncmp ("disabled", option, strlen (option)))
+    fold = 0;
+  else
+    errors->set_code (errors, E_BAD_COMMAND_LINE, 0, 0);
+}
+
+/*
+ * Set the loop tracing option
+ * params:
+ *   char*   option   the option supplied on the command line
+ */
+static void set_tracing (char *option) {
+  if (! strncmp ("enabled", option, strlen (option)))
+    tracing = 1;
+  else if (! strncmp ("disabled", option, strlen (option)))
+    tracing = 0;
+  else
+    errors->set_code (errors, E_BAD_COMMAND_LINE, 0, 0);
+}
+
+/*
+ * Set the output flush policy
+ * params:
+ *   char*   option   the option supplied on the command line
+ */
+static void set_flush (char *option) {
+  if (! strncmp ("line", option, strlen (option)))
+    flush_policy = FLUSH_LINE;
+  else if (! strncmp ("block", option, strlen (option)))
+    flush_policy = FLUSH_BLOCK;
+  else if (! strncmp ("exit", option, strlen (option)))
+    flush_policy = FLUSH_EXIT;
   else
     errors->set_code (errors, E_BAD_COMMAND_LINE, 0, 0);
 }
@@ -158,6 +226,40 @@ static void set_options (int argc, char **argv) {
     else if (! strncmp (argv[argn], "--gosub-limit=", 14))
       set_gosub_limit (&argv[argn][14]);
 
+    /* scan for constant folding option */
+    else if (! strncmp (argv[argn], "-f", 2))
+      set_fold (&argv[argn][2]);
+    else if (! strncmp (argv[argn], "--fold=", 7))
+      set_fold (&argv[argn][7]);
+
+    /* scan for loop tracing option */
+    else if (! strncmp (argv[argn], "-t", 2))
+      set_tracing (&argv[argn][2]);
+    else if (! strncmp (argv[argn], "--trace=", 8))
+      set_tracing (&argv[argn][8]);
+
+    /* scan for output flush policy */
+    else if (! strncmp (argv[argn], "-F", 2))
+      set_flush (&argv[argn][2]);
+    else if (! strncmp (argv[argn], "--flush=", 8))
+      set_flush (&argv[argn][8]);
+
+    /* scan for a prepared file of INPUT data */
+    else if (! strncmp (argv[argn], "-I", 2))
+      data_filename = &argv[argn][2];
+    else if (! strncmp (argv[argn], "--input=", 8))
+      data_filename = &argv[argn][8];
+
+    /* scan for statistics option */
+    else if (! strcmp (argv[argn], "-S")
+      || ! strcmp (argv[argn], "--statistics"))
+      statistics = 1;
+
+    /* scan for profile option */
+    else if (! strcmp (argv[argn], "-P")
+      || ! strcmp (argv[argn], "--profile"))
+      profiling = 1;
+
     /* accept filename */
     else if (! input_filename)
       input_filename = argv[argn];
@@ -189,11 +291,9 @@ static void output_lst (ProgramNode *program) {
     if ((output = fopen (output_filename, "w"))) {
 
       /* write to the output file */
-      formatter = new_Formatter (errors);
+      formatter = new_Formatter (errors, output);
       if (formatter) {
         formatter->generate (formatter, program);
-        if (formatter->output)
-          fprintf (output, "%s", formatter->output);
         formatter->destroy (formatter);
       }
       fclose (output);
@@ -212,6 +312,44 @@ static void output_lst (ProgramNode *program) {
     errors->set_code (errors, E_MEMORY, 0, 0);
 }
 
+/*
+ * Write a profile report in text and JSON form
+ * params:
+ *   Profile*   profile   the profile to write
+ */
+static void output_profile (Profile *profile) {
+
+  /* local variables */
+  FILE *output; /* the output file */
+  char *output_filename; /* the output filename */
+
+  /* ascertain the output filenames */
+  output_filename = malloc (strlen (input_filename) + 11);
+  if (! output_filename) {
+    errors->set_code (errors, E_MEMORY, 0, 0);
+    return;
+  }
+
+  /* write the text report */
+  sprintf (output_filename, "%s.prof", input_filename);
+  if ((output = fopen (output_filename, "w"))) {
+    profile_write_text (profile, output);
+    fclose (output);
+  } else
+    printf ("Error: cannot write file %s\n", output_filename);
+
+  /* write the JSON report */
+  sprintf (output_filename, "%s.prof.json", input_filename);
+  if ((output = fopen (output_filename, "w"))) {
+    profile_write_json (profile, output);
+    fclose (output);
+  } else
+    printf ("Error: cannot write file %s\n", output_filename);
+
+  /* free the output filename */
+  free (output_filename);
+}
+
 /*
  * Output a C source file
  * params:
@@ -294,6 +432,42 @@ static void output_exe (char *command, char *basic_filename) {
 }
 
 
+/*
+ * Run a program from a shared object in the cache, compiling it if need be
+ * params:
+ *   ProgramNode*   program   the program to compile
+ *   char*          command   the compiler command
+ * returns:
+ *   int                      !0 if the program was run
+ */
+static int output_run (ProgramNode *program, char *command) {
+
+  /* local variables */
+  CProgram *c_program; /* the C program */
+  char *path = NULL; /* the cache path of the shared object */
+  int run = 0; /* !0 if the program was run */
+
+  /* generate the C program, and find or build its shared object */
+  if ((c_program = new_CProgram (errors, loptions))) {
+    c_program->generate (c_program, program);
+    if (c_program->c_output
+      && (path = loader_cache_path (c_program->c_output, command))) {
+      run = ! access (path, R_OK) && loader_run (path);
+      if (! run && loader_build (path, c_program->c_output, command))
+        run = loader_run (path);
+    }
+    c_program->destroy (c_program);
+  }
+
+  /* report failure and clean up */
+  if (! run)
+    printf ("Error: cannot build a shared object for %s\n", input_filename);
+  if (path)
+    free (path);
+  return run;
+}
+
+
 /*
  * Top Level Routine
  */
@@ -312,9 +486,15 @@ int main (int argc, char **argv) {
   /* local variables */
   FILE *input; /* input file */
   ProgramNode *program; /* the parsed program */
-  ErrorCode code; /* error returned */
+  ErrorCode code, /* error returned */
+    status = E_NONE; /* the exit status */
   Parser *parser; /* parser object */
+  Linker *linker; /* linker object */
   Interpreter *interpreter; /* interpreter object */
+  Bytecode *bytecode; /* bytecode compiler and virtual machine */
+  JIT *jit; /* native code compiler */
+  Profile *profile = NULL; /* line profile of the run */
+  InputBuffer *data = NULL; /* prepared INPUT data, if supplied */
   char
     *error_text, /* error text message */
     *command; /* command for compilation */
@@ -332,7 +512,7 @@ int main (int argc, char **argv) {
     return 0;
   }
 
-  /* otherwise attempt to open the file */
+  /* attempt to open the file */
   if (!(input = fopen (input_filename, "r"))) {
     printf ("Error: cannot open file %s\n", input_filename);
     errors->destroy (errors);
@@ -346,27 +526,103 @@ int main (int argc, char **argv) {
   parser->destroy (parser);
   fclose (input);
 
+  /* flatten the expressions and resolve constant jump targets, except
+     for a listing, which is neither folded nor needs the targets */
+  if (! errors->get_code (errors)) {
+    program_flatten (program);
+    if (fold && output != OUTPUT_LST)
+      program_fold (program);
+    if (output != OUTPUT_LST) {
+      linker = new_Linker (errors, loptions);
+      linker->link (linker, program);
+      linker->destroy (linker);
+    }
+  }
+
   /* deal with errors */
   if ((code = errors->get_code (errors))) {
     error_text = errors->get_text (errors);
     printf ("Parse error: %s\n", error_text);
     free (error_text);
+    program_destroy (program);
     loptions->destroy (loptions);
     errors->destroy (errors);
     return code;
   }
 
+  /* load any prepared INPUT data */
+  if (data_filename
+    && (output == OUTPUT_INTERPRET || output == OUTPUT_BYTECODE
+    || output == OUTPUT_JIT)
+    && ! (data = input_load (data_filename))) {
+    printf ("Error: cannot open file %s\n", data_filename);
+    program_destroy (program);
+    loptions->destroy (loptions);
+    errors->destroy (errors);
+    return E_FILE_NOT_FOUND;
+  }
+
   /* perform the desired action */
   switch (output) {
+    case OUTPUT_JIT:
+      if ((jit = new_JIT (errors, loptions))) {
+        jit->set_flush_policy (jit, flush_policy);
+        jit->set_input (jit, data);
+        jit->compile (jit, program);
+        if (! errors->get_code (errors))
+          jit->run (jit);
+        if (statistics)
+          fprintf (stderr, "Peak GOSUB depth: %d\n",
+            jit->get_gosub_peak (jit));
+        jit->destroy (jit);
+        if ((code = errors->get_code (errors))) {
+          error_text = errors->get_text (errors);
+          printf ("Runtime error: %s\n", error_text);
+          free (error_text);
+        }
+        break;
+      }
+      /* no native code for this machine, so interpret instead */
     case OUTPUT_INTERPRET:
+      program_fuse (program);
       interpreter = new_Interpreter (errors, loptions);
+      interpreter->set_flush_policy (interpreter, flush_policy);
+      interpreter->set_input (interpreter, data);
+      interpreter->set_tracing (interpreter, tracing);
+      if (profiling) {
+        profile = profile_create (program);
+        interpreter->set_profile (interpreter, profile);
+      }
       interpreter->interpret (interpreter, program);
+      if (statistics)
+        fprintf (stderr, "Peak GOSUB depth: %d\n",
+          interpreter->get_gosub_peak (interpreter));
       interpreter->destroy (interpreter);
       if ((code = errors->get_code (errors))) {
         error_text = errors->get_text (errors);
         printf ("Runtime error: %s\n", error_text);
         free (error_text);
       }
+      if (profile) {
+        output_profile (profile);
+        profile_destroy (profile);
+      }
+      break;
+    case OUTPUT_BYTECODE:
+      bytecode = new_Bytecode (errors, loptions);
+      bytecode->set_input (bytecode, data);
+      bytecode->compile (bytecode, program);
+      if (! errors->get_code (errors))
+        bytecode->run (bytecode);
+      if (statistics)
+        fprintf (stderr, "Peak GOSUB depth: %d\n",
+          bytecode->get_gosub_peak (bytecode));
+      bytecode->destroy (bytecode);
+      if ((code = errors->get_code (errors))) {
+        error_text = errors->get_text (errors);
+        printf ("Runtime error: %s\n", error_text);
+        free (error_text);
+      }
       break;
     case OUTPUT_LST:
       output_lst (program);
@@ -381,12 +637,19 @@ int main (int argc, char **argv) {
       } else
         printf ("TBEXE not set.\n");
       break;
+    case OUTPUT_RUN:
+      if (! (command = getenv ("TBSO")))
+        command = DEFAULT_TBSO;
+      if (! output_run (program, command))
+        status = E_FILE_NOT_FOUND;
+      break;
   }
 
-  /* clean up and return success */
+  /* clean up and return success, unless a shared object failed */
+  input_destroy (data);
   program_destroy (program);
   loptions->destroy (loptions);
   errors->destroy (errors);
-  return 0;
+  return status;
 
 }
@@ -24,7 +24,8 @@ typedef struct {
   TokenClass class; /* class of token */
   int line; /* line on which token was found */
   int pos; /* position within the line on which token was found */
-  char *content; /* representation of token */
+  char *content; /* start of the token in the source text */
+  int length; /* length of the token in the source text */
 } Private;
 
 
@@ -83,11 +84,11 @@ static int get_pos (Token *token) {
 }
 
 /*
- * Return the content of the token begins
+ * Return the content of the token, which is not terminated
  * params:
  *   Token*   token   the token object
  * returns:
- *   char*            the text content of the token
+ *   char*            the start of the token's source text
  */
 static char *get_content (Token *token) {
   this = token;
@@ -95,6 +96,19 @@ static char *get_content (Token *token) {
   return data->content;
 }
 
+/*
+ * Return the length of the token's content
+ * params:
+ *   Token*   token   the token object
+ * returns:
+ *   int              the length of the token's source text
+ */
+static int get_length (Token *token) {
+  this = token;
+  data = token->data;
+  return data->length;
+}
+
 /*
  * Set the token class
  * params:
@@ -122,18 +136,17 @@ static void set_line_pos (Token *token, int line, int pos) {
 }
 
 /*
- * Set the token's text content
+ * Set the token's text content as a slice of the source text
  * params:
  *   Token*   token     the token to alter
- *   char*    content   the text content to set
+ *   char*    content   the start of the token's source text
+ *   int      length    the length of the token's source text
  */
-static void set_content (Token *token, char *content) {
+static void set_content (Token *token, char *content, int length) {
   this = token;
   data = this->data;
-  if (data->content)
-    free (data->content);
-  data->content = malloc (strlen (content) + 1);
-  strcpy (data->content, content);
+  data->content = content;
+  data->length = length;
 }
 
 /*
@@ -143,10 +156,11 @@ static void set_content (Token *token, char *content) {
  *   TokenClass   class     class of token to initialise
  *   int          line      line on which the token occurred
  *   int          pos       character position on which the token occurred
- *   char*        content   the textual content of the token
+ *   char*        content   the start of the token's source text
+ *   int          length    the length of the token's source text
  */
 static void initialise (Token *token, TokenClass class, int line, int pos,
-  char *content) {
+  char *content, int length) {
 
   /* set convenience variables */
   this = token;
@@ -159,7 +173,7 @@ static void initialise (Token *token, TokenClass class, int line, int pos,
 
   /* initialise the content */
   if (content)
-    set_content (this, content);
+    set_content (this, content, length);
 }
 
 /*
@@ -170,8 +184,6 @@ static void initialise (Token *token, TokenClass class, int line, int pos,
 static void destroy (Token *token) {
   if ((this = token)) {
     data = this->data;
-    if (data->content)
-      free (data->content);
     free (data);
     free (this);
   }
@@ -198,6 +210,7 @@ Token *new_Token (void) {
   data->class = TOKEN_NONE;
   data->line = data->pos = 0;
   data->content = NULL;
+  data->length = 0;
 
   /* set up methods */
   this->initialise = initialise;
@@ -205,6 +218,7 @@ Token *new_Token (void) {
   this->get_line = get_line;
   this->get_pos = get_pos;
   this->get_content = get_content;
+  this->get_length = get_length;
   this->set_class = set_class;
   this->set_line_pos = set_line_pos;
   this->set_content = set_content;
@@ -220,15 +234,17 @@ Token *new_Token (void) {
  *   TokenClass   class     class of token to initialise
  *   int          line      line on which the token occurred
  *   int          pos       character position on which the token occurred
- *   char*        content   the textual content of the token
+ *   char*        content   the start of the token's source text
+ *   int          length    the length of the token's source text
  * returns:
  *   Token*                 the created token
  */
-Token *new_Token_init (TokenClass class, int line, int pos, char *content) {
+Token *new_Token_init (TokenClass class, int line, int pos, char *content,
+  int length) {
 
   /* create a blank token */
   this = new_Token ();
-  this->initialise (this, class, line, pos, content);
+  this->initialise (this, class, line, pos, content, length);
 
   /* return the new token */
   return this;
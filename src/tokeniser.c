@@ -13,7 +13,6 @@
 #include <string.h>
 #include "token.h"
 #include "tokeniser.h"
-#include "common.h"
 
 
 /*
@@ -21,32 +20,24 @@
  */
 
 
-/* modes of reading */
-typedef enum {
-  DEFAULT_MODE, /* we have no idea what's coming */
-  COMMENT_MODE, /* reading a comment */
-  WORD_MODE, /* reading an identifier or keyword */
-  NUMBER_MODE, /* reading a numeric constant */
-  LESS_THAN_MODE, /* reading an operator staring with < */
-  GREATER_THAN_MODE, /* reading an operator starting with > */
-  STRING_LITERAL_MODE, /* reading a string literal */
-  UNKNOWN_MODE /* we are lost */
-} Mode;
+/* the initial size of the source buffer */
+#define SOURCE_BLOCK_SIZE 65536
 
-/* current state information */
-typedef struct {
-  Token *token; /* token to return */
-  Mode mode; /* current reading mode */
-  int ch; /* last-read character */
-  char *content; /* content of token under construction */
-  int max; /* memory reserved for content */
-} TokeniserState;
+/* the initial size of a batch of token records */
+#define TOKEN_BLOCK_SIZE 4096
+
+/* character classes */
+#define IS_LETTER(ch) \
+  (((ch) >= 'A' && (ch) <= 'Z') || ((ch) >= 'a' && (ch) <= 'z'))
+#define IS_DIGIT(ch) ((ch) >= '0' && (ch) <= '9')
 
 /* Private data */
 typedef struct {
-  FILE *input; /* the input file */
+  char *source; /* the whole of the source text */
+  long size; /* the length of the source text */
+  long offset; /* offset of the next character to read */
+  long line_start; /* offset of the start of the current line */
   int line, /* current line in the input file */
-    pos, /* current position on the input line */
     start_line, /* line on which a token started */
     start_pos; /* position on which a token started */
 } Private;
@@ -63,79 +54,38 @@ static Private *data; /* private data for this */
 
 
 /*
- * Level 2 Tokeniser Routines
+ * Level 3 Tokeniser Routines
  */
 
 
 /*
- * Read a character and update the position counter
- * globals:
- *   int               line    current line after character read
- *   int               pos     current character position after character read
+ * Read the whole of the source file into memory
  * params:
- *   TokeniserState*   state   current state of the tokeniser
+ *   FILE*   input   the input file
+ *   long*   size    the length of the source text read
  * returns:
- *   int              character just read
- */
-static int read_character (TokeniserState *state) {
-
-  int ch; /* character read from stream */
-
-  /* read the character */
-  ch = fgetc (data->input);
-
-  /* update the position and line counters */
-  if (ch == '\n') {
-    ++data->line;
-    data->pos = 0;
-  } else {
-    ++data->pos;
-  }
-
-  /* return the character */
-  return ch;
-}
-
-/* 
- * Push a character back into the input stream and update position markers
- * globals:
- *   int               line    line number rolled back
- *   int               pos     character position rolled back
- * params:
- *   TokeniserState*   state   current state of the tokeniser
+ *   char*           the source text, with a terminating NUL
  */
-static void unread_character (TokeniserState *state) {
-  ungetc (state->ch, data->input);
-  if (state->ch == '\n')
-    --data->line;
-  else
-    --data->pos;
-}
+static char *read_source (FILE *input, long *size) {
 
-/*
- * Append the last read character to the token content
- * params:
- *   TokeniserState*   state   current state of the tokeniser
- */
-static void store_character (TokeniserState *state) {
-
-  /* variable declarations */
-  char *temp; /* temporary pointer to content */
-  int length; /* current length of token */
-
-  /* allocate more memory for the token content if necessary */
-  if (strlen (state->content) == state->max - 1) {
-    temp = state->content;
-    state->max *= 2;
-    state->content = malloc (state->max);
-    strcpy (state->content, temp);
-    free (temp);
-  }
+  /* local variables */
+  char *source; /* the source text */
+  long max; /* memory reserved for the source text */
+  size_t count; /* number of characters read in one go */
+
+  /* read in blocks, doubling the buffer whenever it fills */
+  max = SOURCE_BLOCK_SIZE;
+  source = malloc (max + 1);
+  *size = 0;
+  while ((count = fread (source + *size, 1, max - *size, input)) > 0)
+    if ((*size += count) == max) {
+      max *= 2;
+      source = realloc (source, max + 1);
+    }
 
-  /* now add the character to the token */
-  length = strlen (state->content);
-  state->content [length++] = state->ch;
-  state->content [length] = '\0';
+  /* terminate the text, so that numbers can be converted in place */
+  source [*size] = '\0';
+  return source;
 }
 
 /*
@@ -176,300 +126,309 @@ static TokenClass identify_symbol (int ch) {
   }
 }
 
-static TokenClass identify_word (char *word) {
-  if (strlen (word) == 1)
+/*
+ * Compare the rest of a word with the rest of a keyword, ignoring case.
+ * As with tinybasic_strcmp, only the characters they have in common are
+ * compared, so REMARK is REM and GO is GOTO.
+ * params:
+ *   char*   word      the word in the source, after its first letter
+ *   int     length    the remaining length of the word
+ *   char*   keyword   the keyword, after its first letter
+ * returns:
+ *   int               !0 if the word matches the keyword
+ */
+static int match_keyword (char *word, int length, char *keyword) {
+  while (length-- && *keyword)
+    if ((*word++ & ~0x20) != *keyword++)
+      return 0;
+  return 1;
+}
+
+/*
+ * Identify a word as a variable or keyword. The first letter selects the
+ * keywords worth comparing, tried in the same order as they always were
+ * so that abbreviations still resolve the same way.
+ * params:
+ *   char*   word     the start of the word in the source
+ *   int     length   the length of the word
+ * returns:
+ *   TokenClass       the token class recognised by the parser
+ */
+static TokenClass identify_word (char *word, int length) {
+
+  /* single letters are variables */
+  if (length == 1)
     return TOKEN_VARIABLE;
-  else if (! tinybasic_strcmp (word, "LET"))
-    return TOKEN_LET;
-  else if (! tinybasic_strcmp (word, "IF"))
-    return TOKEN_IF;
-  else if (! tinybasic_strcmp (word, "THEN"))
-    return TOKEN_THEN;
-  else if (! tinybasic_strcmp (word, "GOTO"))
-    return TOKEN_GOTO;
-  else if (! tinybasic_strcmp (word, "GOSUB"))
-    return TOKEN_GOSUB;
-  else if (! tinybasic_strcmp (word, "RETURN"))
-    return TOKEN_RETURN;
-  else if (! tinybasic_strcmp (word, "END"))
-    return TOKEN_END;
-  else if (! tinybasic_strcmp (word, "PRINT"))
-    return TOKEN_PRINT;
-  else if (! tinybasic_strcmp (word, "INPUT"))
-    return TOKEN_INPUT;
-  else if (! tinybasic_strcmp (word, "REM"))
-    return TOKEN_REM;
-  else
-    return TOKEN_WORD;
+
+  /* otherwise look for keywords with the same initial */
+  switch (*word & ~0x20) {
+    case 'E':
+      if (match_keyword (word + 1, length - 1, "ND"))
+        return TOKEN_END;
+      break;
+    case 'G':
+      if (match_keyword (word + 1, length - 1, "OTO"))
+        return TOKEN_GOTO;
+      if (match_keyword (word + 1, length - 1, "OSUB"))
+        return TOKEN_GOSUB;
+      break;
+    case 'I':
+      if (match_keyword (word + 1, length - 1, "F"))
+        return TOKEN_IF;
+      if (match_keyword (word + 1, length - 1, "NPUT"))
+        return TOKEN_INPUT;
+      break;
+    case 'L':
+      if (match_keyword (word + 1, length - 1, "ET"))
+        return TOKEN_LET;
+      break;
+    case 'P':
+      if (match_keyword (word + 1, length - 1, "RINT"))
+        return TOKEN_PRINT;
+      break;
+    case 'R':
+      if (match_keyword (word + 1, length - 1, "ETURN"))
+        return TOKEN_RETURN;
+      if (match_keyword (word + 1, length - 1, "EM"))
+        return TOKEN_REM;
+      break;
+    case 'T':
+      if (match_keyword (word + 1, length - 1, "HEN"))
+        return TOKEN_THEN;
+      break;
+  }
+
+  /* anything else is an unrecognised word */
+  return TOKEN_WORD;
 }
 
 /*
  * Identify compound (multi-character) symbols.
- * Also identifies some single-character symbols that can form
+ * Also identifies the single-character symbols that can form
  * the start of multi-character symbols.
  * params:
- *   char*   symbol   the symbol to identify
+ *   char*   symbol   the start of the symbol in the source
+ *   int     length   the length of the symbol
  * returns:
  *   TokenClass       the identification
  */
-static TokenClass identify_compound_symbol (char *symbol) {
-  if (! strcmp (symbol, "<>")
-      || ! strcmp (symbol, "><"))
-    return TOKEN_UNEQUAL;
-  else if (! strcmp (symbol, "<"))
-    return TOKEN_LESSTHAN;
-  else if (! strcmp (symbol, "<="))
-    return TOKEN_LESSOREQUAL;
-  else if (! strcmp (symbol, ">"))
-    return TOKEN_GREATERTHAN;
-  else if (! strcmp (symbol, ">="))
-    return TOKEN_GREATEROREQUAL;
+static TokenClass identify_compound_symbol (char *symbol, int length) {
+  if (length == 1)
+    return (*symbol == '<') ? TOKEN_LESSTHAN : TOKEN_GREATERTHAN;
+  else if (symbol [1] == '=')
+    return (*symbol == '<') ? TOKEN_LESSOREQUAL : TOKEN_GREATEROREQUAL;
   else
-    return TOKEN_SYMBOL;
+    return TOKEN_UNEQUAL;
 }
 
 
 /*
- * Level 1 Tokeniser Routines
+ * Level 2 Tokeniser Routines
  */
 
 
 /*
- * Default mode - deal with character when state is unknown
+ * Fill in a token record starting at the recorded start position
  * globals:
- *   int               line         current line in the source file
- *   int               pos          current character position in the source
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
+ *   int            start_line   line on which the current token started
+ *   int            start_pos    char pos on which the current token started
  * params:
- *   TokeniserState*   state        current state of the tokeniser
+ *   TokenRecord*   record       the record to fill in
+ *   TokenClass     class        the class of the token
+ *   long           start        offset of the token's content in the source
+ *   long           length       length of the token's content
+ * returns:
+ *   int                         !0, to show that a token was made
  */
-static void default_mode (TokeniserState *state) {
-
-  /* deal with non-EOL whitespace */
-  if (state->ch == ' ' ||
-      state->ch == '\t') {
-    state->ch = read_character (state);
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-  }
-
-  /* deal with EOL whitespace */
-  else if (state->ch == '\n') {
-    data->start_line = data->line - 1;
-    data->start_pos = data->pos;
-    state->token = new_Token_init
-      (TOKEN_EOL, data->start_line, data->start_pos, state->content);
-  }
-
-  /* alphabetic characters start a word */
-  else if ((state->ch >= 'A' && state->ch <= 'Z') ||
-	   (state->ch >= 'a' && state->ch <= 'z')) {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    state->mode = WORD_MODE;
-  }
-
-  /* digits start a number */
-  else if (state->ch >= '0' && state->ch <= '9')
-    state->mode = NUMBER_MODE;
-
-  /* check for tokens starting with less-than (<, <=, <>) */
-  else if (state->ch == '<') {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    store_character (state);
-    state->ch = read_character (state);
-    state->mode = LESS_THAN_MODE;
-  }
-
-  /* check for tokens starting with greater-than (>, >=) */
-  else if (state->ch == '>') {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    store_character (state);
-    state->ch = read_character (state);
-    state->mode = GREATER_THAN_MODE;
-  }
-
-  /* deal with other symbol operators */
-  else if (strchr ("+-*/=(),", state->ch) != NULL) {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    store_character (state);
-    state->token = new_Token_init (identify_symbol (state->ch),
-      data->start_line, data->start_pos, state->content);
-  }
-
-  /* double quotes start a string literal */
-  else if (state->ch == '"') {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    state->ch = read_character (state);
-    state->mode = STRING_LITERAL_MODE;
-  }
-
-  /* detect end of file */
-  else if (state->ch == EOF) {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    state->token = new_Token_init
-      (TOKEN_EOF, data->start_line, data->start_pos, state->content);
-  }
+static int make_token (TokenRecord *record, TokenClass class, long start,
+  long length) {
+  record->class = class;
+  record->line = data->start_line;
+  record->pos = data->start_pos;
+  record->content = data->source + start;
+  record->length = (int) length;
+  return !0;
+}
 
-  /* other characters are illegal */
-  else {
-    data->start_line = data->line;
-    data->start_pos = data->pos;
-    store_character (state);
-    state->token = new_Token_init
-      (TOKEN_ILLEGAL, data->start_line, data->start_pos, state->content);
-  }
+/*
+ * Skip the remainder of a line after a REM
+ */
+static void skip_comment (void) {
+  while (data->offset < data->size && data->source [data->offset] != '\n')
+    ++data->offset;
 }
 
 /*
- * Word mode - deal with character when building a word token
- * globals:
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
+ * Read an identifier or keyword
  * params:
- *   TokeniserState*   state        current state of the tokeniser
+ *   TokenRecord*   record   the record to fill in
+ * returns:
+ *   int                     !0 if a token was made, 0 if the word was a REM
  */
-static void word_mode (TokeniserState *state) {
+static int read_word (TokenRecord *record) {
 
   /* local variables */
+  long start; /* offset of the start of the word */
   TokenClass class; /* recognised class of keyword */
-    
-  /* add letters and digits to the token */
-  if ((state->ch >= 'A' && state->ch <= 'Z') ||
-      (state->ch >= 'a' && state->ch <= 'z')) {
-    store_character (state);
-    state->ch = read_character (state);
-  }
-    
-  /* other characters are pushed back for the next token */
-  else {
-    if (state->ch != EOF)
-      unread_character (state);
-    class = identify_word (state->content);
-    if (class == TOKEN_REM) {
-      *state->content = '\0';
-      state->mode = COMMENT_MODE;
-    }
-    else
-      state->token = new_Token_init
-        (class, data->start_line, data->start_pos, state->content);
+
+  /* find the end of the word */
+  start = data->offset;
+  while (IS_LETTER (data->source [data->offset]))
+    ++data->offset;
+
+  /* identify the word, skipping the rest of the line after a REM */
+  class = identify_word (data->source + start, data->offset - start);
+  if (class == TOKEN_REM) {
+    skip_comment ();
+    return 0;
   }
+  return make_token (record, class, start, data->offset - start);
 }
 
 /*
- * Comment mode - skip till end of line after a REM
- * globals:
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
+ * Read a number token (integer only)
  * params:
- *   TokeniserState*   state        current state of the tokeniser
+ *   TokenRecord*   record   the record to fill in
+ * returns:
+ *   int                     !0, to show that a token was made
  */
-static void comment_mode (TokeniserState *state) {
-  if (state->ch == '\n')
-    state->mode = DEFAULT_MODE;
-  else
-    state->ch = read_character (state);
+static int read_number (TokenRecord *record) {
+  long start; /* offset of the start of the number */
+  start = data->offset;
+  while (IS_DIGIT (data->source [data->offset]))
+    ++data->offset;
+  return make_token (record, TOKEN_NUMBER, start, data->offset - start);
 }
 
 /*
- * Number mode - building a number token (integer only)
- * globals:
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
+ * Read an operator starting with < or >, checking for <>, <=, >< and >=
  * params:
- *   TokeniserState*   state        current state of the tokeniser
+ *   TokenRecord*   record   the record to fill in
+ * returns:
+ *   int                     !0, to show that a token was made
  */
-static void number_mode (TokeniserState *state) {
-
-  /* add digits to the token */
-  if (state->ch >= '0' && state->ch <= '9') {
-    store_character (state);
-    state->ch = read_character (state);
-  }
-    
-  /* other characters are pushed back for the next token */
-  else {
-    if (state->ch != EOF)
-      unread_character (state);
-    state->token = new_Token_init
-      (TOKEN_NUMBER, data->start_line, data->start_pos, state->content);
-  }
+static int read_compound_symbol (TokenRecord *record) {
 
+  /* local variables */
+  long start; /* offset of the start of the operator */
+  int ch; /* the character following the < or > */
+
+  /* take a second character if it completes a compound symbol */
+  start = data->offset++;
+  ch = data->source [data->offset];
+  if (ch == '=' || (ch == '<' && data->source [start] == '>')
+    || (ch == '>' && data->source [start] == '<'))
+    ++data->offset;
+  return make_token (record,
+    identify_compound_symbol (data->source + start, data->offset - start),
+    start, data->offset - start);
 }
 
 /*
- * Less than mode - checking for <> and <= operators
- * globals:
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
+ * Read a string literal. Escape sequences are left in the content, for
+ * the parser to process when it copies the string.
  * params:
- *   TokeniserState*   state        current state of the tokeniser
+ *   TokenRecord*   record   the record to fill in
+ * returns:
+ *   int                     !0, to show that a token was made
  */
-static void less_than_mode (TokeniserState *state) {
-  if (state->ch == '=' || state->ch == '>')
-    store_character (state);
-  else
-    unread_character (state);
-  state->token = new_Token_init
-    (identify_compound_symbol (state->content), data->start_line,
-     data->start_pos, state->content);
+static int read_string (TokenRecord *record) {
+
+  /* local variables */
+  long start; /* offset of the start of the string content */
+
+  /* look for the closing quote */
+  start = ++data->offset;
+  while (data->offset < data->size && data->source [data->offset] != '"') {
+
+    /* a backslash escapes the next character */
+    if (data->source [data->offset] == '\\')
+      ++data->offset;
+
+    /* keep count of lines within the string */
+    else if (data->source [data->offset] == '\n') {
+      ++data->line;
+      data->line_start = data->offset + 1;
+    }
+    ++data->offset;
+  }
+
+  /* EOF generates an error */
+  if (data->offset >= data->size) {
+    data->offset = data->size;
+    return make_token (record, TOKEN_ILLEGAL, start, data->offset - start);
+  }
+
+  /* skip the closing quote and return the string */
+  ++data->offset;
+  return make_token (record, TOKEN_STRING, start, data->offset - start - 1);
 }
 
+
 /*
- * Greater than mode - checking for >= and >< operators
- * globals:
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
- * params:
- *   TokeniserState*   state        current state of the tokeniser
+ * Level 1 Tokeniser Routines
  */
-static void greater_than_mode (TokeniserState *state) {
-  if (state->ch == '=' || state->ch == '<')
-    store_character (state);
-  else
-    ungetc (state->ch, data->input);
-  state->token = new_Token_init
-    (identify_compound_symbol (state->content), data->start_line,
-     data->start_pos, state->content);
-}
+
 
 /*
- * String literal mode - reading a string
- * globals:
- *   int               start_line   line on which the current token started
- *   int               start_pos    char pos on which the current token started
+ * Scan the next token from the source
  * params:
- *   TokeniserState*   state        current state of the tokeniser
+ *   TokenRecord*   record   the record to fill in
  */
-static void string_literal_mode (TokeniserState *state) {
-
-  /* a quote terminates the string */
-  if (state->ch == '"')
-    state->token = new_Token_init
-      (TOKEN_STRING, data->start_line, data->start_pos, state->content);
-
-  /* a backslash escapes the next character */
-  else if (state->ch == '\\') {
-    state->ch = read_character (state);
-    store_character (state);
-    state->ch = read_character (state);
-  }
+static void scan_token (TokenRecord *record) {
 
-  /* EOF generates an error */
-  else if (state->ch == EOF)
-    state->token = new_Token_init
-      (TOKEN_ILLEGAL, data->start_line, data->start_pos, state->content);
-
-  /* all other characters are part of the string */
-  else {
-    store_character (state);
-    state->ch = read_character (state);
+  /* local variables */
+  int
+    made = 0, /* !0 when a token has been made */
+    ch; /* the first character of the token */
+
+  /* main loop */
+  while (! made) {
+
+    /* note where the token starts */
+    ch = (unsigned char) data->source [data->offset];
+    data->start_line = data->line;
+    data->start_pos = data->offset - data->line_start + 1;
+
+    /* detect end of file */
+    if (data->offset >= data->size)
+      made = make_token (record, TOKEN_EOF, data->offset, 0);
+
+    /* deal with non-EOL whitespace */
+    else if (ch == ' ' || ch == '\t')
+      ++data->offset;
+
+    /* deal with EOL whitespace */
+    else if (ch == '\n') {
+      data->start_pos = 0;
+      made = make_token (record, TOKEN_EOL, data->offset++, 0);
+      ++data->line;
+      data->line_start = data->offset;
+    }
+
+    /* alphabetic characters start a word */
+    else if (IS_LETTER (ch))
+      made = read_word (record);
+
+    /* digits start a number */
+    else if (IS_DIGIT (ch))
+      made = read_number (record);
+
+    /* check for tokens starting with less-than or greater-than */
+    else if (ch == '<' || ch == '>')
+      made = read_compound_symbol (record);
+
+    /* deal with other symbol operators */
+    else if (ch && strchr ("+-*/=(),", ch) != NULL)
+      made = make_token (record, identify_symbol (ch), data->offset++, 1);
+
+    /* double quotes start a string literal */
+    else if (ch == '"')
+      made = read_string (record);
+
+    /* other characters are illegal */
+    else
+      made = make_token (record, TOKEN_ILLEGAL, data->offset++, 1);
   }
 }
 
@@ -489,57 +448,50 @@ static void string_literal_mode (TokeniserState *state) {
 static Token *next (TokenStream *token_stream) {
 
   /* local variables */
-  TokeniserState state; /* current state of reading */
-  Token *return_token; /* token to return */
+  TokenRecord record; /* the token scanned */
 
   /* initialise */
   this = token_stream;
   data = this->data;
-  state.token = NULL;
-  state.mode = DEFAULT_MODE;
-  state.max = 1024;
-  state.content = malloc (state.max);
-  *(state.content) = '\0';
-  state.ch = read_character (&state);
 
-  /* main loop */
-  while (state.token == NULL) {
-    switch (state.mode) {
-    case DEFAULT_MODE:
-      default_mode (&state);
-      break;
-    case COMMENT_MODE:
-      comment_mode (&state);
-      break;
-    case WORD_MODE:
-      word_mode (&state);
-      break;
-    case NUMBER_MODE:
-      number_mode (&state);
-      break;
-    case LESS_THAN_MODE:
-      less_than_mode (&state);
-      break;
-    case GREATER_THAN_MODE:
-      greater_than_mode (&state);
-      break;
-    case STRING_LITERAL_MODE:
-      string_literal_mode (&state);
-      break;
-    default:
-      state.token = new_Token_init
-	(TOKEN_EOF, data->start_line, data->start_pos, state.content);
-      state.ch = EOF; /* temporary hack */
-    }
-  }
+  /* scan the token and return it as an object */
+  scan_token (&record);
+  return new_Token_init (record.class, record.line, record.pos,
+    record.content, record.length);
+}
 
-  /* store token and release state memory */
-  return_token = state.token;
-  free (state.content);
+/*
+ * Tokenise the rest of the input into an array of token records
+ * params:
+ *   TokenStream*   token_stream   the token stream being processed
+ *   int*           count          the number of records returned
+ * returns:
+ *   TokenRecord*                  the records, ending with TOKEN_EOF
+ */
+static TokenRecord *read_all (TokenStream *token_stream, int *count) {
 
-  /* return result */
-  return return_token;
+  /* local variables */
+  TokenRecord *records; /* the records to return */
+  int max; /* the number of records reserved */
 
+  /* initialise */
+  this = token_stream;
+  data = this->data;
+  max = TOKEN_BLOCK_SIZE;
+  records = malloc (max * sizeof (TokenRecord));
+  *count = 0;
+
+  /* scan tokens up to and including the end of the file */
+  do {
+    if (*count == max) {
+      max *= 2;
+      records = realloc (records, max * sizeof (TokenRecord));
+    }
+    scan_token (&records [*count]);
+  } while (records [(*count)++].class != TOKEN_EOF);
+
+  /* return the records */
+  return records;
 }
 
 /*
@@ -562,8 +514,10 @@ static int get_line (TokenStream *token_stream) {
  */
 static void destroy (TokenStream *token_stream) {
   if (token_stream) {
-    if (token_stream->data)
+    if (token_stream->data) {
+      free (((Private *) token_stream->data)->source);
       free (token_stream->data);
+    }
     free (token_stream);
   }
 }
@@ -589,13 +543,15 @@ TokenStream *new_TokenStream (FILE *input) {
 
   /* initialise methods */
   this->next = next;
+  this->read_all = read_all;
   this->get_line = get_line;
   this->destroy = destroy;
 
   /* initialise data */
-  data->input = input;
+  data->source = read_source (input, &data->size);
+  data->offset = data->line_start = 0;
   data->line = data->start_line = 1;
-  data->pos = data->start_pos = 0;
+  data->start_pos = 0;
 
   /* return new token stream */
   return this;